@@ -29,6 +29,7 @@
 #include <atomic>
 #include <condition_variable>
 #include <mutex>
+#include <thread>
 
 #include <any>
 #include <array>
@@ -858,22 +859,151 @@ namespace dp::util {
     class singleton_with_optional_construction_args {
     private:
         singleton_with_optional_construction_args() = default;
-        static C *_instance;
+        static std::atomic<C *> _instance;
+        static std::mutex _lock;
 
     public:
         ~singleton_with_optional_construction_args() {
-            delete _instance;
-            _instance = nullptr;
+            delete _instance.exchange(nullptr);
         }
+        // the first call constructs the instance with its args, the later ones ignore theirs
         static C &instance(Args... args) {
-            if (_instance == nullptr)
-                _instance = new C(args...);
-            return *_instance;
+            if (C *p = _instance.load(std::memory_order_acquire))
+                return *p;
+            std::lock_guard<std::mutex> l{_lock};
+            C *p = _instance.load(std::memory_order_relaxed);
+            if (p == nullptr) {
+                p = new C(args...);
+                _instance.store(p, std::memory_order_release);
+            }
+            return *p;
         }
     };
 
     template<typename C, typename... Args>
-    C *singleton_with_optional_construction_args<C, Args...>::_instance = nullptr;
+    std::atomic<C *> singleton_with_optional_construction_args<C, Args...>::_instance{nullptr};
+    template<typename C, typename... Args>
+    std::mutex singleton_with_optional_construction_args<C, Args...>::_lock;
+
+    namespace detail {
+        // the shutdown() of every static_singleton alive, in the order of startup
+        struct singleton_lifetimes {
+            static singleton_lifetimes &get() {
+                static singleton_lifetimes lifetimes;
+                return lifetimes;
+            }
+            // a singleton made again after its shutdown moves to the end, it's never listed twice
+            void started(void (*shutdown)()) {
+                std::lock_guard<std::mutex> l{_lock};
+                _shutdowns.erase(std::remove(_shutdowns.begin(), _shutdowns.end(), shutdown), _shutdowns.end());
+                _shutdowns.push_back(shutdown);
+            }
+            void stopped(void (*shutdown)()) {
+                std::lock_guard<std::mutex> l{_lock};
+                _shutdowns.erase(std::remove(_shutdowns.begin(), _shutdowns.end(), shutdown), _shutdowns.end());
+            }
+            std::size_t size() {
+                std::lock_guard<std::mutex> l{_lock};
+                return _shutdowns.size();
+            }
+            void shutdown_all() {
+                for (;;) {
+                    void (*shutdown)(){};
+                    {
+                        std::lock_guard<std::mutex> l{_lock};
+                        if (_shutdowns.empty()) return;
+                        shutdown = _shutdowns.back();
+                        _shutdowns.pop_back();
+                    }
+                    shutdown();
+                }
+            }
+
+        private:
+            std::mutex _lock;
+            std::vector<void (*)()> _shutdowns;
+        };
+    } // namespace detail
+
+    /**
+     * @brief static_singleton keeps the instance of T in aligned static storage
+     * rather than on the heap. Once it is up, instance() is a single acquire
+     * load, with no guard variable to check.
+     *
+     * The instance is made by startup(), or by the first instance() if nobody
+     * called startup(). It is destroyed only by shutdown(), or by
+     * shutdown_static_singletons(), which shuts down every static_singleton
+     * in the reverse order of startup. Nothing is destroyed at exit, so the
+     * program decides the order and no singleton dies under a late user.
+     * An instance may be made again after its shutdown, it's then shut
+     * down once, in the order of its new startup. Shutting down while
+     * other threads still use the instance is the caller's bug.
+     */
+    template<typename T>
+    class static_singleton {
+    public:
+        static T &instance() {
+            if (T *p = _ptr.load(std::memory_order_acquire))
+                return *p;
+            return *startup();
+        }
+        // makes the instance from \a args if it is not up yet
+        template<typename... Args>
+        static T *startup(Args &&...args) {
+            std::lock_guard<std::mutex> l{_lock};
+            T *p = _ptr.load(std::memory_order_relaxed);
+            if (p == nullptr) {
+                p = ::new (static_cast<void *>(_storage)) T(std::forward<Args>(args)...);
+                detail::singleton_lifetimes::get().started(&shutdown);
+                _ptr.store(p, std::memory_order_release);
+            }
+            return p;
+        }
+        static void shutdown() {
+            std::lock_guard<std::mutex> l{_lock};
+            if (T *p = _ptr.exchange(nullptr, std::memory_order_acq_rel)) {
+                detail::singleton_lifetimes::get().stopped(&shutdown);
+                p->~T();
+            }
+        }
+        static bool alive() { return _ptr.load(std::memory_order_acquire) != nullptr; }
+
+    private:
+        alignas(T) static inline unsigned char _storage[sizeof(T)];
+        static inline std::atomic<T *> _ptr{nullptr};
+        static inline std::mutex _lock;
+    };
+
+    // shuts down the static singletons started so far, the last started first
+    inline void shutdown_static_singletons() { detail::singleton_lifetimes::get().shutdown_all(); }
+
+    /**
+     * @brief thread_singleton gives each thread its own instance of T, made on
+     * the first instance() of the thread and destroyed when the thread exits.
+     * Once made, instance() is a load of a thread-local pointer. Suits hot
+     * per-thread state such as counters and scratch buffers.
+     */
+    template<typename T>
+    class thread_singleton {
+    public:
+        static T &instance() {
+            if (T *p = _ptr)
+                return *p;
+            return make();
+        }
+
+    private:
+        struct holder {
+            T value{};
+            holder() { _ptr = &value; }
+            ~holder() { _ptr = nullptr; }
+        };
+        static T &make() {
+            static thread_local holder h;
+            return h.value;
+        }
+        static inline thread_local T *_ptr{nullptr};
+    };
 
 #if defined(_DEBUG) && defined(NEVER_USED)
     inline void test_singleton_with_optional_construction_args() {
@@ -987,6 +1117,120 @@ namespace dp::util {
 
 } // namespace dp::util
 
+// ------------------- mpmc_ring
+namespace dp::util {
+
+    /**
+     * @brief a bounded, lock-free multi-producer/multi-consumer ring buffer.
+     * @tparam T the element type, it must be move-constructible.
+     * @details Dmitry Vyukov's algorithm: every cell carries a sequence
+     * number which tells the producers and the consumers whose turn it
+     * is, so a push or a pop costs a single CAS on the shared cursor in the
+     * uncontended case. The capacity is rounded up to a power of 2.
+     * @code{c++}
+     * dp::util::mpmc_ring&lt;int&gt; ring{1024};
+     * ring.try_push(1);
+     * int v;
+     * if (ring.try_pop(v)) { ... }
+     * @endcode
+     */
+    template<typename T>
+    class mpmc_ring {
+    public:
+        explicit mpmc_ring(std::size_t capacity = 1024)
+            : _mask(round_up(capacity) - 1)
+            , _cells(new cell[_mask + 1]) {
+            for (std::size_t i = 0; i <= _mask; i++)
+                _cells[i].seq.store(i, std::memory_order_relaxed);
+        }
+        ~mpmc_ring() {
+            for (auto pos = _tail.load(); pos != _head.load(); ++pos) {
+                auto &c = _cells[pos & _mask];
+                if (c.seq.load() == pos + 1)
+                    c.ptr()->~T();
+            }
+        }
+        mpmc_ring(const mpmc_ring &) = delete;
+        mpmc_ring &operator=(const mpmc_ring &) = delete;
+
+        std::size_t capacity() const { return _mask + 1; }
+        /**
+         * @brief approximate count of the elements, it's exact only if no one pushes or pops concurrently.
+         */
+        std::size_t size() const {
+            auto tail = _tail.load(std::memory_order_acquire), head = _head.load(std::memory_order_acquire);
+            return head > tail ? head - tail : 0;
+        }
+        bool empty() const { return size() == 0; }
+
+        bool try_push(T const &v) { return try_emplace(v); }
+        bool try_push(T &&v) { return try_emplace(std::move(v)); }
+        template<typename... Args>
+        bool try_emplace(Args &&...args) {
+            cell *c;
+            auto pos = _head.load(std::memory_order_relaxed);
+            for (;;) {
+                c = &_cells[pos & _mask];
+                auto seq = c->seq.load(std::memory_order_acquire);
+                auto diff = (std::intptr_t) seq - (std::intptr_t) pos;
+                if (diff == 0) {
+                    if (_head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                        break;
+                } else if (diff < 0) {
+                    return false; // full
+                } else {
+                    pos = _head.load(std::memory_order_relaxed);
+                }
+            }
+            new (c->ptr()) T(std::forward<Args>(args)...);
+            c->seq.store(pos + 1, std::memory_order_release);
+            return true;
+        }
+
+        bool try_pop(T &out) {
+            cell *c;
+            auto pos = _tail.load(std::memory_order_relaxed);
+            for (;;) {
+                c = &_cells[pos & _mask];
+                auto seq = c->seq.load(std::memory_order_acquire);
+                auto diff = (std::intptr_t) seq - (std::intptr_t) (pos + 1);
+                if (diff == 0) {
+                    if (_tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                        break;
+                } else if (diff < 0) {
+                    return false; // empty
+                } else {
+                    pos = _tail.load(std::memory_order_relaxed);
+                }
+            }
+            out = std::move(*c->ptr());
+            c->ptr()->~T();
+            c->seq.store(pos + _mask + 1, std::memory_order_release);
+            return true;
+        }
+
+    private:
+        static std::size_t round_up(std::size_t n) {
+            std::size_t r = 2;
+            while (r < n) r <<= 1;
+            return r;
+        }
+
+        struct cell {
+            std::atomic<std::size_t> seq;
+            alignas(T) unsigned char storage[sizeof(T)];
+            T *ptr() { return reinterpret_cast<T *>(storage); }
+        };
+
+        static constexpr std::size_t cache_line = 64;
+        std::size_t const _mask;
+        std::unique_ptr<cell[]> _cells;
+        alignas(cache_line) std::atomic<std::size_t> _head{0};
+        alignas(cache_line) std::atomic<std::size_t> _tail{0};
+    };
+
+} // namespace dp::util
+
 // ------------------- observer
 namespace dp::util {
 
@@ -1016,6 +1260,7 @@ namespace dp::util {
         observable &add_observer(observer_t const &o) {
             if (AutoLock) {
                 if (CNS) {
+                    std::lock_guard _w(_wm);
                     auto copy = _observers;
                     copy.push_back(o);
                     std::lock_guard _l(_m);
@@ -1032,6 +1277,7 @@ namespace dp::util {
             observer_t wp = o;
             if (AutoLock) {
                 if (CNS) {
+                    std::lock_guard _w(_wm);
                     auto copy = _observers;
                     copy.push_back(wp);
                     std::lock_guard _l(_m);
@@ -1048,6 +1294,7 @@ namespace dp::util {
         observable &remove_observer(observer_t_nacked *o) {
             if (AutoLock) {
                 if (CNS) {
+                    std::lock_guard _w(_wm);
                     auto copy = _observers;
                     copy.erase(std::remove_if(copy.begin(), copy.end(), [o](observer_t const &rhs) {
                                    if (auto spt = rhs.lock())
@@ -1112,7 +1359,8 @@ namespace dp::util {
 
     private:
         std::vector<observer_t> _observers{};
-        std::mutex _m{};
+        std::mutex _m{};  // guards _observers against emit()
+        std::mutex _wm{}; // serializes the copy-and-swap writers
     };
 
     template<typename S, bool AutoLock = false, bool CNS = true, typename Observer = observer<S>>
@@ -1130,6 +1378,500 @@ namespace dp::util {
         }
     };
 
+    /**
+     * @brief an observable object whose observers list is published as an
+     * immutable snapshot (read-copy-update).
+     * @details emit() takes a reference to the current snapshot and walks
+     * it with no lock held, so the publishers never serialize behind each
+     * other or behind a slow observer for the walk. add_observer() and
+     * remove_observer() copy the list, modify the copy and publish it
+     * atomically; they are serialized with each other by a writers' mutex.
+     * A snapshot is reclaimed by the last emit() still holding it, so an
+     * observer may add or remove observers from observe().
+     *
+     * Taking the reference is an atomic load of a shared_ptr, which is not
+     * lock-free on the usual standard libraries: libstdc++ guards it with
+     * a mutex picked by the address from a small pool. So emit() is not
+     * wait-free, it goes through one short critical section, shared with
+     * the writer publishing a new snapshot and with the other objects
+     * hashed to the same mutex.
+     *
+     * For example:
+     * @code{c++}
+     * class Store : public dp::util::observable_rcu&lt;event&gt; {};
+     * Store store;
+     * Store::observer_t_shared c = std::make_shared&lt;Customer&gt;();
+     * store += c;
+     * std::thread t1([&store] { store.emit(event{}); });
+     * std::thread t2([&store] { store.emit(event{}); });
+     * @endcode
+     * @tparam S         subject or event
+     * @tparam Observer 
+     */
+    template<typename S, typename Observer = observer<S>>
+    class observable_rcu {
+    public:
+        virtual ~observable_rcu() {}
+        using subject_t = S;
+        using observer_t_nacked = Observer;
+        using observer_t = std::weak_ptr<observer_t_nacked>;
+        using observer_t_shared = std::shared_ptr<observer_t_nacked>;
+        using observers_t = std::vector<observer_t>;
+        using snapshot_t = std::shared_ptr<observers_t const>;
+
+        observable_rcu &add_observer(observer_t const &o) {
+            update([&o](observers_t &list) { list.push_back(o); });
+            return (*this);
+        }
+        observable_rcu &add_observer(observer_t_shared &o) { return add_observer(observer_t{o}); }
+        observable_rcu &remove_observer(observer_t_shared &o) { return remove_observer(o.get()); }
+        observable_rcu &remove_observer(observer_t_nacked *o) {
+            update([o](observers_t &list) {
+                // the expired observers are pruned at the same time.
+                list.erase(std::remove_if(list.begin(), list.end(), [o](observer_t const &rhs) {
+                               auto spt = rhs.lock();
+                               return !spt || spt.get() == o;
+                           }),
+                           list.end());
+            });
+            return (*this);
+        }
+        friend observable_rcu &operator+(observable_rcu &lhs, observer_t_shared &o) { return lhs.add_observer(o); }
+        friend observable_rcu &operator+(observable_rcu &lhs, observer_t const &o) { return lhs.add_observer(o); }
+        friend observable_rcu &operator-(observable_rcu &lhs, observer_t_shared &o) { return lhs.remove_observer(o); }
+        friend observable_rcu &operator-(observable_rcu &lhs, observer_t_nacked *o) { return lhs.remove_observer(o); }
+        observable_rcu &operator+=(observer_t_shared &o) { return add_observer(o); }
+        observable_rcu &operator+=(observer_t const &o) { return add_observer(o); }
+        observable_rcu &operator-=(observer_t_shared &o) { return remove_observer(o); }
+        observable_rcu &operator-=(observer_t_nacked *o) { return remove_observer(o); }
+
+    public:
+        /**
+         * @brief fire an event along the observers chain.
+         * @param event_or_subject 
+         * @details It waits for the registration operations no longer than
+         * the swap of the snapshot pointer; the observers added or removed
+         * concurrently will be seen by the next emit().
+         */
+        void emit(subject_t const &event_or_subject) {
+            auto snap = snapshot();
+            for (auto const &wp : *snap)
+                if (auto spt = wp.lock())
+                    spt->observe(event_or_subject);
+        }
+
+        /**
+         * @brief the current immutable observers list.
+         * @details A short critical section on libstdc++, see above.
+         */
+        snapshot_t snapshot() const { return std::atomic_load_explicit(&_snapshot, std::memory_order_acquire); }
+        std::size_t size() const { return snapshot()->size(); }
+
+    protected:
+        template<typename Updater>
+        void update(Updater &&updater) {
+            std::lock_guard _w(_wm);
+            auto copy = std::make_shared<observers_t>(*snapshot());
+            updater(*copy);
+            std::atomic_store_explicit(&_snapshot, snapshot_t{std::move(copy)}, std::memory_order_release);
+        }
+
+    private:
+        snapshot_t _snapshot{std::make_shared<observers_t const>()};
+        std::mutex _wm{};
+    };
+
+    /**
+     * @brief the policies of observable_async when its queue is full.
+     */
+    enum class backpressure {
+        block,       //!< the publisher waits until the dispatcher makes some room.
+        drop_oldest, //!< the oldest queued event is discarded.
+        drop_newest, //!< the event being emitted is discarded.
+    };
+
+    /**
+     * @brief an observable object which delivers the events on its own
+     * dispatcher thread.
+     * @details emit() pushes the event onto a bounded lock-free ring and
+     * returns, so the publisher pays for one enqueue instead of calling
+     * every observer. The dispatcher drains the ring in batches of up to
+     * \a batch_size events; each observer is resolved once per batch and
+     * receives the events of a batch in the emitted order.
+     *
+     * The observers are registered as in observable_rcu, which is a private
+     * base so that its synchronous emit() cannot be reached by mistake. Call
+     * flush() to wait until everything emitted so far is delivered (or
+     * dropped).
+     * @code{c++}
+     * dp::util::observable_async&lt;event&gt; store{1024, dp::util::backpressure::drop_oldest};
+     * store += c;
+     * store.emit(event{});
+     * store.flush();
+     * @endcode
+     * @tparam S         subject or event, it must be default- and move-constructible.
+     * @tparam Observer 
+     */
+    template<typename S, typename Observer = observer<S>>
+    class observable_async : private observable_rcu<S, Observer> {
+    public:
+        using base_t = observable_rcu<S, Observer>;
+        using subject_t = S;
+        using typename base_t::observer_t;
+        using typename base_t::observer_t_nacked;
+        using typename base_t::observer_t_shared;
+        using typename base_t::observers_t;
+        using typename base_t::snapshot_t;
+
+        explicit observable_async(std::size_t capacity = 1024, backpressure policy = backpressure::block, std::size_t batch_size = 64)
+            : _ring(capacity)
+            , _policy(policy)
+            , _batch_size(batch_size ? batch_size : 1)
+            , _dispatcher([this] { run(); }) {}
+        ~observable_async() override { stop(); }
+
+        observable_async &add_observer(observer_t const &o) { return base_t::add_observer(o), *this; }
+        observable_async &add_observer(observer_t_shared &o) { return base_t::add_observer(o), *this; }
+        observable_async &remove_observer(observer_t_shared &o) { return base_t::remove_observer(o), *this; }
+        observable_async &remove_observer(observer_t_nacked *o) { return base_t::remove_observer(o), *this; }
+        friend observable_async &operator+(observable_async &lhs, observer_t_shared &o) { return lhs.add_observer(o); }
+        friend observable_async &operator+(observable_async &lhs, observer_t const &o) { return lhs.add_observer(o); }
+        friend observable_async &operator-(observable_async &lhs, observer_t_shared &o) { return lhs.remove_observer(o); }
+        friend observable_async &operator-(observable_async &lhs, observer_t_nacked *o) { return lhs.remove_observer(o); }
+        observable_async &operator+=(observer_t_shared &o) { return add_observer(o); }
+        observable_async &operator+=(observer_t const &o) { return add_observer(o); }
+        observable_async &operator-=(observer_t_shared &o) { return remove_observer(o); }
+        observable_async &operator-=(observer_t_nacked *o) { return remove_observer(o); }
+        using base_t::size;
+        using base_t::snapshot;
+
+    public:
+        /**
+         * @brief post an event to the observers.
+         * @return false if the event was dropped (backpressure::drop_newest, or stopped).
+         */
+        bool emit(subject_t const &event_or_subject) { return post(subject_t{event_or_subject}); }
+        bool emit(subject_t &&event_or_subject) { return post(std::move(event_or_subject)); }
+
+        /**
+         * @brief wait until all events emitted before this call have been
+         * delivered or dropped.
+         * @details Calling it from an observer (on the dispatcher thread) is a no-op.
+         */
+        void flush() {
+            if (std::this_thread::get_id() == _dispatcher.get_id())
+                return;
+            auto target = _enqueued.load();
+            std::unique_lock l(_m);
+            _cv_done.wait(l, [this, target] { return _done.load() >= target || _stopped.load(); });
+        }
+
+        /**
+         * @brief deliver the pending events and stop the dispatcher thread.
+         */
+        void stop() {
+            {
+                std::lock_guard l(_m);
+                if (_stopping.exchange(true)) return;
+            }
+            _cv_work.notify_all();
+            if (_dispatcher.joinable())
+                _dispatcher.join();
+            {
+                std::lock_guard l(_m);
+                _stopped = true;
+            }
+            _cv_done.notify_all();
+        }
+
+        std::size_t pending() const { return (std::size_t) (_enqueued.load() - _done.load()); }
+        std::size_t dropped() const { return (std::size_t) _dropped.load(); }
+        backpressure policy() const { return _policy; }
+
+    private:
+        bool post(subject_t &&e) {
+            // reserve first: the dispatcher does not exit while _enqueued is
+            // ahead of _done, so an event reserved before stop() is delivered
+            _enqueued++;
+            if (_stopping.load()) {
+                _enqueued--;
+                _cv_work.notify_all();
+                return false;
+            }
+            while (!_ring.try_push(std::move(e))) {
+                switch (_policy) {
+                    case backpressure::drop_newest:
+                        _dropped++;
+                        retire(1);
+                        return false;
+                    case backpressure::drop_oldest: {
+                        subject_t victim{};
+                        if (_ring.try_pop(victim)) {
+                            _dropped++;
+                            retire(1);
+                        }
+                        break;
+                    }
+                    default: {
+                        // the dispatcher notifies _cv_done after each batch it
+                        // pops, and it keeps draining while this event is reserved
+                        wake();
+                        std::unique_lock l(_m);
+                        _cv_done.wait(l, [this] { return _ring.size() < _ring.capacity(); });
+                        break;
+                    }
+                }
+            }
+            wake();
+            return true;
+        }
+
+        void wake() {
+            if (_sleeping.load()) {
+                { std::lock_guard l(_m); }
+                _cv_work.notify_one();
+            }
+        }
+
+        void retire(std::size_t n) {
+            _done += n;
+            { std::lock_guard l(_m); }
+            _cv_done.notify_all();
+        }
+
+        void run() {
+            std::vector<subject_t> batch;
+            batch.reserve(_batch_size);
+            for (;;) {
+                subject_t e{};
+                while (batch.size() < _batch_size && _ring.try_pop(e))
+                    batch.push_back(std::move(e));
+
+                if (!batch.empty()) {
+                    deliver(batch);
+                    retire(batch.size());
+                    batch.clear();
+                    continue;
+                }
+
+                std::unique_lock l(_m);
+                _sleeping = true;
+                _cv_work.wait(l, [this] { return _enqueued.load() != _done.load() || _stopping.load(); });
+                _sleeping = false;
+                if (_stopping.load() && _enqueued.load() == _done.load())
+                    break;
+            }
+        }
+
+        void deliver(std::vector<subject_t> const &batch) {
+            auto snap = base_t::snapshot();
+            for (auto const &wp : *snap)
+                if (auto spt = wp.lock())
+                    for (auto const &e : batch)
+                        spt->observe(e);
+        }
+
+    private:
+        mpmc_ring<subject_t> _ring;
+        backpressure const _policy;
+        std::size_t const _batch_size;
+        std::atomic<std::uint64_t> _enqueued{0}, _done{0}, _dropped{0};
+        std::atomic<bool> _stopping{false}, _stopped{false}, _sleeping{false};
+        std::mutex _m{};
+        std::condition_variable _cv_work{}, _cv_done{};
+        std::thread _dispatcher; // keep it the last one, it starts in the constructor
+    };
+
+    /**
+     * @brief the handle returned by observable_tracked::subscribe().
+     * @details The generation tells a stale handle, whose slot has been
+     * reused by a later subscription, from the live one.
+     */
+    struct subscription {
+        std::uint32_t index{npos};
+        std::uint32_t generation{};
+        static constexpr std::uint32_t npos = std::uint32_t(-1);
+        bool valid() const { return index != npos; }
+        explicit operator bool() const { return valid(); }
+        bool operator==(subscription const &o) const { return index == o.index && generation == o.generation; }
+        bool operator!=(subscription const &o) const { return !(*this == o); }
+    };
+
+    /**
+     * @brief an observable object which holds its observers through
+     * generation-counted subscriptions.
+     * @details The observers are kept in a contiguous array. subscribe()
+     * shares the ownership of the observer until it is unsubscribed, so
+     * an observer nobody else holds keeps receiving events, and emit()
+     * calls it through a plain pointer. subscribe_weak() tracks it by a
+     * weak_ptr instead: emit() locks that per event, and an observer that
+     * expired without unsubscribing is skipped and compacted away, as
+     * subscribe() does with all the expired ones each time the array has
+     * doubled. The array is compacted in O(1) per removal (swap with the
+     * last one), so the delivery order is not kept after a removal.
+     *
+     * An observer may unsubscribe itself, or others, from within observe()
+     * if AutoLock is false; the removal is then applied once the outermost
+     * emit() returns.
+     * @code{c++}
+     * dp::util::observable_tracked&lt;event&gt; store;
+     * auto id = store.subscribe(std::make_shared&lt;Customer&gt;());
+     * store.emit(event{});
+     * store.unsubscribe(id);
+     * @endcode
+     * @tparam S         subject or event
+     * @tparam AutoLock  thread-safe even if modifying observers chain dynamically
+     * @tparam Observer 
+     */
+    template<typename S, bool AutoLock = false, typename Observer = observer<S>>
+    class observable_tracked {
+    public:
+        virtual ~observable_tracked() {}
+        using subject_t = S;
+        using observer_t_nacked = Observer;
+        using observer_t_shared = std::shared_ptr<observer_t_nacked>;
+        using lock_t = std::conditional_t<AutoLock, std::mutex, cool::lock_guard<void>>;
+
+        subscription subscribe(observer_t_shared const &o) { return add(entry{o, {}, o.get(), 0}); }
+        /**
+         * @brief subscribe \a o without owning it, it is dropped once it expires.
+         */
+        subscription subscribe_weak(observer_t_shared const &o) { return add(entry{{}, o, o.get(), 0}); }
+
+        /**
+         * @brief remove an observer, a stale or invalid handle is ignored.
+         * @return true if the subscription was alive.
+         */
+        bool unsubscribe(subscription const &id) {
+            std::lock_guard _l(_m);
+            if (!alive(id) || _dense[_slots[id.index].dense].raw == nullptr) return false;
+            if (_emitting > 0) {
+                _dense[_slots[id.index].dense].raw = nullptr;
+                _deferred = true;
+            } else
+                remove_at(_slots[id.index].dense);
+            return true;
+        }
+        observable_tracked &operator-=(subscription const &id) {
+            unsubscribe(id);
+            return (*this);
+        }
+
+        bool contains(subscription const &id) const {
+            std::lock_guard _l(_m);
+            return alive(id) && !dead(_dense[_slots[id.index].dense]);
+        }
+        /**
+         * @brief the count of the subscriptions, the expired ones included until a sweep.
+         */
+        std::size_t size() const {
+            std::lock_guard _l(_m);
+            return _dense.size();
+        }
+
+        /**
+         * @brief drop the expired observers, and apply the removals deferred by
+         * unsubscribe() calls made during an emission; emit() does it too once
+         * the outermost emission returns.
+         */
+        void sweep() {
+            std::lock_guard _l(_m);
+            sweep_unlocked();
+        }
+
+    public:
+        /**
+         * @brief fire an event along the observers chain.
+         * @param event_or_subject 
+         */
+        void emit(subject_t const &event_or_subject) {
+            std::lock_guard _l(_m);
+            _emitting++;
+            for (std::size_t i = 0; i < _dense.size(); i++) {
+                auto &e = _dense[i];
+                if (!e.raw) continue;
+                if (e.sp)
+                    e.raw->observe(event_or_subject);
+                else if (auto sp = e.wp.lock())
+                    sp->observe(event_or_subject);
+                else
+                    e.raw = nullptr, _deferred = true;
+            }
+            if (--_emitting == 0 && _deferred)
+                sweep_unlocked();
+        }
+
+    private:
+        struct slot {
+            std::uint32_t dense{subscription::npos};
+            std::uint32_t generation{};
+        };
+        struct entry {
+            observer_t_shared sp;                // set if owned
+            std::weak_ptr<observer_t_nacked> wp; // set if tracked weakly
+            observer_t_nacked *raw;
+            std::uint32_t index; // back reference into _slots
+        };
+
+        subscription add(entry &&e) {
+            std::lock_guard _l(_m);
+            if (_dense.size() >= _sweep_at)
+                sweep_unlocked();
+            std::uint32_t index;
+            if (!_free.empty()) {
+                index = _free.back();
+                _free.pop_back();
+            } else {
+                index = (std::uint32_t) _slots.size();
+                _slots.push_back(slot{});
+            }
+            e.index = index;
+            _slots[index].dense = (std::uint32_t) _dense.size();
+            _dense.push_back(std::move(e));
+            return subscription{index, _slots[index].generation};
+        }
+
+        // unsubscribed during an emission, or expired
+        static bool dead(entry const &e) { return e.raw == nullptr || (!e.sp && e.wp.expired()); }
+
+        bool alive(subscription const &id) const {
+            return id.index < _slots.size() && _slots[id.index].generation == id.generation && _slots[id.index].dense != subscription::npos;
+        }
+
+        void remove_at(std::size_t pos) {
+            auto index = _dense[pos].index;
+            if (pos + 1 != _dense.size()) {
+                _dense[pos] = std::move(_dense.back());
+                _slots[_dense[pos].index].dense = (std::uint32_t) pos;
+            }
+            _dense.pop_back();
+            _slots[index].dense = subscription::npos;
+            _slots[index].generation++;
+            _free.push_back(index);
+        }
+
+        void sweep_unlocked() {
+            if (_emitting > 0) {
+                _deferred = true;
+                return;
+            }
+            _deferred = false;
+            for (std::size_t i = _dense.size(); i-- > 0;)
+                if (dead(_dense[i]))
+                    remove_at(i);
+            _sweep_at = std::max<std::size_t>(16, _dense.size() * 2);
+        }
+
+    private:
+        std::vector<entry> _dense{};
+        std::vector<slot> _slots{};
+        std::vector<std::uint32_t> _free{};
+        std::size_t _sweep_at{16};
+        int _emitting{};
+        bool _deferred{};
+        mutable lock_t _m{};
+    };
+
     /**
      * @brief an observable object, which allows a lambda or a function to be bound as the observer.
      * @tparam S subject or event will be emitted to all bound observers.
@@ -1172,29 +1914,135 @@ namespace dp::util {
 // ------------------- signal & slot
 namespace dp::util {
 
+    namespace detail {
+        struct connection_body {
+            std::atomic<bool> connected{true};
+        };
+    } // namespace detail
+
+    /**
+     * @brief the handle of a slot connected by signal&lt;&gt;::connect().
+     * @details Copies of a connection refer to the same slot. disconnect()
+     * is O(1), thread-safe, and may be called from within the slot while
+     * the signal is being emitted.
+     */
+    class connection {
+    public:
+        connection() = default;
+        explicit connection(std::shared_ptr<detail::connection_body> body)
+            : _body(std::move(body)) {}
+
+        void disconnect() {
+            if (_body) _body->connected.store(false, std::memory_order_release);
+        }
+        bool connected() const { return _body && _body->connected.load(std::memory_order_acquire); }
+        explicit operator bool() const { return connected(); }
+        bool operator==(connection const &o) const { return _body == o._body; }
+        bool operator!=(connection const &o) const { return _body != o._body; }
+
+    private:
+        std::shared_ptr<detail::connection_body> _body{};
+    };
+
+    /**
+     * @brief a RAII connection which disconnects its slot when it goes out of scope.
+     * @code{c++}
+     * {
+     *   dp::util::scoped_connection sc = sig.connect(&receiver::on, &r);
+     *   sig.emit(1);
+     * } // r is not connected any more
+     * @endcode
+     */
+    class scoped_connection {
+    public:
+        scoped_connection() = default;
+        scoped_connection(connection const &c)
+            : _c(c) {}
+        scoped_connection(scoped_connection &&o) noexcept
+            : _c(o.release()) {}
+        scoped_connection &operator=(scoped_connection &&o) noexcept {
+            if (this != &o) {
+                _c.disconnect();
+                _c = o.release();
+            }
+            return *this;
+        }
+        scoped_connection(scoped_connection const &) = delete;
+        scoped_connection &operator=(scoped_connection const &) = delete;
+        ~scoped_connection() { _c.disconnect(); }
+
+        void disconnect() { _c.disconnect(); }
+        bool connected() const { return _c.connected(); }
+        explicit operator bool() const { return connected(); }
+        /**
+         * @brief give up the ownership, the slot stays connected.
+         */
+        connection release() {
+            auto c = _c;
+            _c = connection{};
+            return c;
+        }
+
+    private:
+        connection _c{};
+    };
+
     /**
      * @brief A covered pure C++ implementation for QT signal-slot mechanism
      * @tparam SignalSubjects 
+     * @details connect() returns a connection handle for disconnecting the
+     * slot later. The slots list is published as an immutable snapshot:
+     * emit() walks the snapshot taken at its beginning, so connect() and
+     * disconnect() on other threads never block the emitters, and a slot
+     * may disconnect itself or others while being called. A slot which is
+     * disconnected during an emission is not called after that.
+     *
+     * The slots share the subjects by const reference, so they are not
+     * copied per slot and may be move-only. A slot taking them by value
+     * copies them as usual, one taking an rvalue reference gets a copy of
+     * its own. connect() returns the connection handle, which can connect
+     * the next slot as well: sig.connect(a).connect(b).
      */
     template<typename... SignalSubjects>
     class signal {
     public:
         virtual ~signal() { clear(); }
-        using FN = std::function<void(SignalSubjects &&...)>;
+        using FN = std::function<void(SignalSubjects const &...)>;
         static constexpr std::size_t SubjectCount = sizeof...(SignalSubjects);
 
+        /**
+         * @brief the connection returned by connect(), it connects the next slot too.
+         */
+        class chained_connection : public connection {
+        public:
+            chained_connection(connection const &c, signal &sig)
+                : connection(c)
+                , _sig(&sig) {}
+            template<typename _Callable, typename... _Args>
+            chained_connection connect(_Callable &&f, _Args &&...args) {
+                return _sig->connect(std::forward<_Callable>(f), std::forward<_Args>(args)...);
+            }
+
+        private:
+            signal *_sig;
+        };
+
         template<typename _Callable, typename... _Args>
-        signal &connect(_Callable &&f, _Args &&...args) {
+        chained_connection connect(_Callable &&f, _Args &&...args) {
             using namespace std::placeholders;
-            FN fn = cool::bind_tie<SubjectCount>(std::forward<_Callable>(f), std::forward<_Args>(args)..., _1, _2, _3, _4, _5, _6, _7, _8, _9);
-            _callbacks.push_back(fn);
-            return (*this);
+            auto bound = cool::bind_tie<SubjectCount>(std::forward<_Callable>(f), std::forward<_Args>(args)..., _1, _2, _3, _4, _5, _6, _7, _8, _9);
+            FN fn;
+            if constexpr (std::is_invocable_v<decltype(bound) &, SignalSubjects const &...>)
+                fn = std::move(bound);
+            else // it takes the subjects by rvalue reference, give it a copy
+                fn = [bound = std::move(bound)](SignalSubjects const &...subjects) mutable { bound(SignalSubjects(subjects)...); };
+            auto body = std::make_shared<detail::connection_body>();
+            update([&fn, &body](slots_t &list) { list.push_back(slot{std::move(fn), body}); });
+            return chained_connection{connection{body}, *this};
         }
         template<typename _Callable, typename... _Args>
         signal &on(_Callable &&f, _Args &&...args) {
-            using namespace std::placeholders;
-            FN fn = util::cool::bind_tie<SubjectCount>(std::forward<_Callable>(f), std::forward<_Args>(args)..., _1, _2, _3, _4, _5, _6, _7, _8, _9);
-            _callbacks.push_back(fn);
+            connect(std::forward<_Callable>(f), std::forward<_Args>(args)...);
             return (*this);
         }
 
@@ -1203,17 +2051,201 @@ namespace dp::util {
          * @param event_or_subject 
          */
         signal &emit(SignalSubjects &&...event_or_subjects) {
-            for (auto &fn : _callbacks)
-                fn(std::move(event_or_subjects)...);
+            auto snap = std::atomic_load_explicit(&_slots, std::memory_order_acquire);
+            for (auto const &s : *snap)
+                if (s.body->connected.load(std::memory_order_acquire))
+                    s.fn(event_or_subjects...);
             return (*this);
         }
-        signal &operator()(SignalSubjects &&...event_or_subjects) { return emit(event_or_subjects...); }
+        signal &operator()(SignalSubjects &&...event_or_subjects) { return emit(std::move(event_or_subjects)...); }
+
+        /**
+         * @brief disconnect all slots.
+         */
+        void clear() {
+            update([](slots_t &list) {
+                for (auto &s : list) s.body->connected.store(false, std::memory_order_release);
+                list.clear();
+            });
+        }
+        /**
+         * @brief the count of connected slots.
+         */
+        std::size_t size() const {
+            auto snap = std::atomic_load_explicit(&_slots, std::memory_order_acquire);
+            return (std::size_t) std::count_if(snap->begin(), snap->end(), [](slot const &s) { return s.body->connected.load(); });
+        }
 
     private:
-        void clear() {}
+        struct slot {
+            FN fn;
+            std::shared_ptr<detail::connection_body> body;
+        };
+        using slots_t = std::vector<slot>;
+
+        template<typename Updater>
+        void update(Updater &&updater) {
+            std::lock_guard _w(_wm);
+            auto snap = std::atomic_load_explicit(&_slots, std::memory_order_acquire);
+            auto copy = std::make_shared<slots_t>();
+            copy->reserve(snap->size() + 1);
+            for (auto const &s : *snap) // the disconnected slots are pruned here
+                if (s.body->connected.load(std::memory_order_acquire))
+                    copy->push_back(s);
+            updater(*copy);
+            std::atomic_store_explicit(&_slots, std::shared_ptr<slots_t const>{std::move(copy)}, std::memory_order_release);
+        }
 
     private:
-        std::vector<FN> _callbacks{};
+        std::shared_ptr<slots_t const> _slots{std::make_shared<slots_t const>()};
+        std::mutex _wm{};
+    };
+
+} // namespace dp::util
+
+// ------------------- inplace_function & inplace_signal
+namespace dp::util {
+
+    template<typename Signature, std::size_t Capacity = 4 * sizeof(void *)>
+    class inplace_function;
+
+    /**
+     * @brief a std::function alike wrapper which keeps the callable inside
+     * itself and never allocates.
+     * @details A callable larger than \a Capacity bytes is rejected at
+     * compile time; bind an object by pointer or std::ref to keep it small.
+     * The callable must be copy-constructible and nothrow
+     * move-constructible, since the moves of an inplace_function are
+     * noexcept. Calling it costs one indirect call to a thunk which
+     * invokes the stored callable directly.
+     * @tparam R 
+     * @tparam Args 
+     * @tparam Capacity the inline storage size in bytes
+     */
+    template<typename R, typename... Args, std::size_t Capacity>
+    class inplace_function<R(Args...), Capacity> {
+    public:
+        static constexpr std::size_t capacity = Capacity;
+
+        inplace_function() = default;
+        inplace_function(std::nullptr_t) {}
+        template<typename F, typename T = std::decay_t<F>,
+                 std::enable_if_t<!std::is_same_v<T, inplace_function> && std::is_invocable_r_v<R, T &, Args...>, int> = 0>
+        inplace_function(F &&f) {
+            static_assert(sizeof(T) <= Capacity, "the callable is too large for the inline storage");
+            static_assert(alignof(T) <= alignof(std::max_align_t), "the callable is over-aligned");
+            static_assert(std::is_copy_constructible_v<T>, "the callable must be copy-constructible");
+            static_assert(std::is_nothrow_move_constructible_v<T>, "the callable must be nothrow move-constructible, the moves of inplace_function are noexcept");
+            new (_buf) T(std::forward<F>(f));
+            _invoke = [](void *p, Args... args) -> R { return (*static_cast<T *>(p))(std::forward<Args>(args)...); };
+            _manage = [](op o, void *dst, void *src) {
+                switch (o) {
+                    case op::copy: new (dst) T(*static_cast<T const *>(src)); break;
+                    case op::move: new (dst) T(std::move(*static_cast<T *>(src))); break;
+                    case op::destroy: static_cast<T *>(dst)->~T(); break;
+                }
+            };
+        }
+        inplace_function(inplace_function const &o) { assign(o, op::copy); }
+        inplace_function(inplace_function &&o) noexcept { assign(o, op::move); }
+        ~inplace_function() { reset(); }
+        inplace_function &operator=(inplace_function const &o) {
+            if (this != &o) {
+                reset();
+                assign(o, op::copy);
+            }
+            return *this;
+        }
+        inplace_function &operator=(inplace_function &&o) noexcept {
+            if (this != &o) {
+                reset();
+                assign(o, op::move);
+            }
+            return *this;
+        }
+
+        explicit operator bool() const { return _invoke != nullptr; }
+        R operator()(Args... args) const { return _invoke(_buf, std::forward<Args>(args)...); }
+
+        void reset() {
+            if (_manage) _manage(op::destroy, _buf, nullptr);
+            _invoke = nullptr, _manage = nullptr;
+        }
+
+    private:
+        enum class op { copy,
+                        move,
+                        destroy };
+        void assign(inplace_function const &o, op how) {
+            if (o._manage) o._manage(how, _buf, const_cast<unsigned char *>(o._buf));
+            _invoke = o._invoke, _manage = o._manage;
+        }
+
+        alignas(std::max_align_t) mutable unsigned char _buf[Capacity];
+        R (*_invoke)(void *, Args...){};
+        void (*_manage)(op, void *, void *){};
+    };
+
+    /**
+     * @brief A signal-slot mechanism like signal&lt;&gt;, but the slots are
+     * inplace_function objects stored in a contiguous array.
+     * @details Connecting never allocates per slot (only the array grows),
+     * and emit() is a tight loop of direct calls. The slots receive the
+     * subjects by const reference.
+     * @code{c++}
+     * struct foo { void bar(float, int) {} };
+     * foo ff;
+     * dp::util::inplace_signal&lt;float, int&gt; sig;
+     * sig.connect(&foo::bar, &ff);
+     * sig.connect([](float, int) {});
+     * sig.emit(1.f, 2);
+     * @endcode
+     * @tparam SignalSubjects 
+     */
+    template<typename... SignalSubjects>
+    class inplace_signal {
+    public:
+        using slot_t = inplace_function<void(SignalSubjects const &...)>;
+        static constexpr std::size_t SubjectCount = sizeof...(SignalSubjects);
+
+        /**
+         * @brief connect a function object, a lambda or a function pointer.
+         */
+        template<typename _Callable>
+        inplace_signal &connect(_Callable &&f) {
+            _slots.emplace_back(std::forward<_Callable>(f));
+            return (*this);
+        }
+        /**
+         * @brief connect a member function with its instance (an object, or a pointer to it).
+         */
+        template<typename _MemFn, typename _Instance,
+                 std::enable_if_t<std::is_member_function_pointer_v<_MemFn>, int> = 0>
+        inplace_signal &connect(_MemFn f, _Instance &&ii) {
+            _slots.emplace_back([f, o = std::forward<_Instance>(ii)](SignalSubjects const &...args) mutable {
+                std::invoke(f, o, args...);
+            });
+            return (*this);
+        }
+        template<typename... _Args>
+        inplace_signal &on(_Args &&...args) { return connect(std::forward<_Args>(args)...); }
+
+        /**
+         * @brief fire an event along the slots.
+         */
+        inplace_signal &emit(SignalSubjects const &...event_or_subjects) {
+            for (auto const &fn : _slots)
+                fn(event_or_subjects...);
+            return (*this);
+        }
+        inplace_signal &operator()(SignalSubjects const &...event_or_subjects) { return emit(event_or_subjects...); }
+
+        std::size_t size() const { return _slots.size(); }
+        void reserve(std::size_t n) { _slots.reserve(n); }
+        void clear() { _slots.clear(); }
+
+    private:
+        std::vector<slot_t> _slots{};
     };
 
 } // namespace dp::util
@@ -11,14 +11,441 @@
 #ifndef DESIGN_PATTERNS_CXX_DP_MEDIATOR_HH
 #define DESIGN_PATTERNS_CXX_DP_MEDIATOR_HH
 
+#include "dp-common.hh" // mpmc_ring
+
 #include <type_traits>
 
 #include <memory>
 
 #include <optional>
 
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <vector>
+
 namespace dp::mediator {
 
+    template<typename Message, typename Id, typename Hash>
+    class mediator_t;
+
+    /**
+     * @brief colleague_t is the base of the objects talking through a mediator_t.
+     * @details A colleague gets its messages in on_message(), one at a
+     * time: a colleague is never called by two threads at once, though
+     * different colleagues run in parallel on the workers of the mediator.
+     *
+     * Call leave() before destroying a colleague; the destructor leaves
+     * too, but the derived parts are gone by then.
+     */
+    template<typename Message, typename Id = std::uint64_t, typename Hash = std::hash<Id>>
+    class colleague_t {
+    public:
+        using mediator_type = mediator_t<Message, Id, Hash>;
+        virtual ~colleague_t() { leave(); }
+
+        Id const &id() const { return _id; }
+        mediator_type *mediator() const { return _mediator; }
+        bool joined() const { return _mediator != nullptr; }
+
+        /** @brief send \a msg to the colleague \a to, returns false if there is no such one. */
+        bool send(Id const &to, Message msg) { return _mediator && _mediator->send(_id, to, std::move(msg)); }
+        /** @brief broadcast \a msg to all the others, returns the count of the receivers. */
+        std::size_t broadcast(Message const &msg) { return _mediator ? _mediator->broadcast(_id, msg) : 0; }
+
+        void leave() {
+            if (_mediator) _mediator->leave(_id);
+        }
+
+    protected:
+        virtual void on_message(Id const &from, Message &&msg) = 0;
+
+    private:
+        friend mediator_type;
+        mediator_type *_mediator{};
+        Id _id{};
+    };
+
+    /**
+     * @brief mediator_t routes the messages among its colleagues.
+     *
+     * The colleagues join by id. The routing table is a fixed array of
+     * lock-free bucket lists: a lookup is a hash and a walk without any
+     * lock, only join() takes a mutex. A node is never freed before the
+     * mediator, so a colleague who leaves and joins again with the same id
+     * reuses it.
+     *
+     * Every colleague has its own mailbox (dp::util::mpmc_ring). Posting
+     * to a colleague whose mailbox was idle puts it on the run queue,
+     * where the workers pick it and deliver up to \a batch messages at a
+     * time, so one colleague sees its messages in order and never
+     * concurrently. With no workers, the messages are delivered by the
+     * threads calling poll().
+     *
+     * A full mailbox makes the sender wait (or poll, with no workers).
+     * A colleague sending from on_message() polls instead, since the one
+     * it waits for might be waiting for it in turn: if that delivers
+     * nothing, the message is parked in the overflow list of the receiver,
+     * which is drained after its mailbox, so no two colleagues wait for
+     * each other forever. Once the mediator is stopping, a full mailbox
+     * parks the message at once, and stop() waits for the sends in
+     * progress, so every message posted is delivered or dropped. The
+     * Message type must be default- and move-constructible.
+     *
+     * @code{c++}
+     * struct peer : dp::mediator::colleague_t&lt;std::string&gt; {
+     *     void on_message(std::uint64_t const &from, std::string &&msg) override { ... }
+     * };
+     * dp::mediator::mediator_t&lt;std::string&gt; m{4};
+     * peer a, b;
+     * m.join(1, a);
+     * m.join(2, b);
+     * a.send(2, "hello");
+     * a.broadcast("hi all");
+     * m.flush();
+     * @endcode
+     */
+    template<typename Message, typename Id = std::uint64_t, typename Hash = std::hash<Id>>
+    class mediator_t {
+    public:
+        using Self = mediator_t<Message, Id, Hash>;
+        using colleague_type = colleague_t<Message, Id, Hash>;
+
+        explicit mediator_t(std::size_t workers = std::max(1u, std::thread::hardware_concurrency()),
+                            std::size_t buckets = 1024,
+                            std::size_t mailbox_capacity = 256,
+                            std::size_t batch = 64)
+            : _mask(round_up(buckets) - 1)
+            , _buckets(new std::atomic<node *>[_mask + 1])
+            , _mailbox_capacity(mailbox_capacity)
+            , _batch(batch ? batch : 1)
+            , _run_queue(4096) {
+            for (std::size_t i = 0; i <= _mask; i++)
+                _buckets[i].store(nullptr, std::memory_order_relaxed);
+            _workers.reserve(workers);
+            for (std::size_t i = 0; i < workers; i++)
+                _workers.emplace_back([this] { run(); });
+        }
+        ~mediator_t() {
+            stop();
+            for (auto *n = _all.load(); n;) {
+                auto *next = n->next_all;
+                if (auto *c = n->target.load())
+                    c->_mediator = nullptr;
+                delete n;
+                n = next;
+            }
+        }
+        mediator_t(mediator_t const &) = delete;
+        mediator_t &operator=(mediator_t const &) = delete;
+
+    public:
+        /**
+         * @brief join registers \a c as \a id.
+         * @return false if the id is taken or \a c has joined already.
+         */
+        bool join(Id const &id, colleague_type &c) {
+            std::lock_guard l(_wm);
+            if (c._mediator) return false;
+            auto *n = find(id);
+            if (!n) {
+                n = new node(id, _mailbox_capacity);
+                auto &head = _buckets[Hash{}(id) & _mask];
+                n->next = head.load(std::memory_order_relaxed);
+                n->next_all = _all.load(std::memory_order_relaxed);
+                head.store(n, std::memory_order_release);
+                _all.store(n, std::memory_order_release);
+            } else if (n->target.load()) {
+                return false;
+            }
+            c._mediator = this;
+            c._id = id;
+            n->target.store(&c);
+            _size++;
+            return true;
+        }
+
+        /**
+         * @brief leave unregisters the colleague \a id.
+         * @details It waits for the delivery in progress to that colleague,
+         * unless it is called from there. The messages still queued for it
+         * are dropped.
+         */
+        void leave(Id const &id) {
+            auto *n = find(id);
+            if (!n) return;
+            auto *c = n->target.exchange(nullptr);
+            if (!c) return;
+            while (n->draining.load() && current() != n)
+                std::this_thread::yield();
+            c->_mediator = nullptr;
+            _size--;
+        }
+
+        bool contains(Id const &id) const {
+            auto *n = find(id);
+            return n && n->target.load(std::memory_order_acquire);
+        }
+        std::size_t size() const { return _size.load(std::memory_order_relaxed); }
+
+        /**
+         * @brief send posts \a msg to the colleague \a to.
+         * @return false if there is no such colleague or the mediator stopped.
+         */
+        bool send(Id const &from, Id const &to, Message msg) {
+            auto *n = find(to);
+            if (!n || !n->target.load(std::memory_order_acquire) || !enter())
+                return false;
+            post(n, from, std::move(msg));
+            _inflight--;
+            return true;
+        }
+
+        /**
+         * @brief broadcast posts a copy of \a msg to every colleague but the sender.
+         * @return the count of the receivers.
+         */
+        std::size_t broadcast(Id const &from, Message const &msg) {
+            if (!enter())
+                return 0;
+            std::size_t count{};
+            for (auto *n = _all.load(std::memory_order_acquire); n; n = n->next_all) {
+                if (n->id == from || !n->target.load(std::memory_order_acquire))
+                    continue;
+                post(n, from, Message{msg});
+                count++;
+            }
+            _inflight--;
+            return count;
+        }
+
+        /**
+         * @brief poll delivers the pending messages on the calling thread.
+         * @return the count of the messages delivered.
+         */
+        std::size_t poll(std::size_t max_messages = std::size_t(-1)) {
+            std::size_t count{};
+            node *n{};
+            while (count < max_messages && _run_queue.try_pop(n)) {
+                _ready--;
+                count += drain(n);
+            }
+            return count;
+        }
+
+        /**
+         * @brief flush waits until every message posted so far is delivered or dropped.
+         * @details Calling it from a colleague is a no-op.
+         */
+        void flush() {
+            if (current()) return;
+            auto target = _posted.load();
+            if (_workers.empty()) {
+                while (_processed.load() < target)
+                    if (!poll()) std::this_thread::yield();
+                return;
+            }
+            _flushers++;
+            std::unique_lock l(_m);
+            _cv_done.wait(l, [this, target] { return _processed.load() >= target || _stopped; });
+            _flushers--;
+        }
+
+        /**
+         * @brief stop delivers the pending messages and joins the workers.
+         */
+        void stop() {
+            {
+                std::lock_guard l(_m);
+                if (_stopping.exchange(true)) return;
+            }
+            _cv_work.notify_all();
+            for (auto &t : _workers)
+                if (t.joinable()) t.join();
+            // the sends which got in before _stopping was set may still be posting
+            while (_inflight.load())
+                if (!poll()) std::this_thread::yield();
+            while (poll()) {}
+            {
+                std::lock_guard l(_m);
+                _stopped = true;
+            }
+            _cv_done.notify_all();
+        }
+
+        std::uint64_t posted() const { return _posted.load(); }
+        std::uint64_t delivered() const { return _processed.load() - _dropped.load(); }
+        std::uint64_t dropped() const { return _dropped.load(); }
+
+    private:
+        struct envelope {
+            Id from{};
+            Message msg{};
+        };
+
+        struct node {
+            node(Id const &id_, std::size_t capacity)
+                : id(id_)
+                , mailbox(capacity) {}
+            Id const id;
+            std::atomic<colleague_type *> target{nullptr};
+            std::atomic<bool> scheduled{false};
+            std::atomic<bool> draining{false};
+            dp::util::mpmc_ring<envelope> mailbox;
+            std::atomic<std::size_t> overflowed{0}; // the size of overflow
+            std::mutex overflow_m{};
+            std::deque<envelope> overflow{};
+            node *next{};     // in the bucket
+            node *next_all{}; // in the list of all nodes
+        };
+
+        // counts a send in, unless the mediator is stopping; stop() waits for the ones counted
+        bool enter() {
+            _inflight++;
+            if (!_stopping.load())
+                return true;
+            _inflight--;
+            return false;
+        }
+
+        node *find(Id const &id) const {
+            for (auto *n = _buckets[Hash{}(id) & _mask].load(std::memory_order_acquire); n; n = n->next)
+                if (n->id == id) return n;
+            return nullptr;
+        }
+
+        void post(node *n, Id const &from, Message &&msg) {
+            _posted++;
+            envelope e{from, std::move(msg)};
+            // once a message is parked, the later ones follow it to keep the order
+            while (n->overflowed.load() || !n->mailbox.try_push(std::move(e))) {
+                if (_workers.empty() || current() || _stopping.load()) {
+                    if (!n->overflowed.load() && !_stopping.load() && poll(_batch))
+                        continue;
+                    std::lock_guard l(n->overflow_m);
+                    n->overflow.push_back(std::move(e));
+                    n->overflowed++;
+                    break;
+                }
+                std::this_thread::yield();
+            }
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (!n->scheduled.exchange(true))
+                schedule(n);
+        }
+
+        void schedule(node *n) {
+            _ready++;
+            while (!_run_queue.try_push(n)) {
+                if (_workers.empty() || current() || _stopping.load())
+                    poll(_batch);
+                else
+                    std::this_thread::yield();
+            }
+            if (_idle.load()) {
+                { std::lock_guard l(_m); }
+                _cv_work.notify_one();
+            }
+        }
+
+        // delivers a batch of the mailbox of a scheduled node, and
+        // reschedules it if more messages came in meanwhile.
+        std::size_t drain(node *n) {
+            auto *saved = current();
+            current() = n;
+            n->draining.store(true);
+            auto *c = n->target.load();
+            std::size_t count{};
+            envelope e{};
+            while (count < _batch && (n->mailbox.try_pop(e) || pop_overflow(n, e))) {
+                if (c)
+                    c->on_message(e.from, std::move(e.msg));
+                else
+                    _dropped++;
+                count++;
+            }
+            n->draining.store(false);
+            current() = saved;
+
+            n->scheduled.store(false);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if ((!n->mailbox.empty() || n->overflowed.load()) && !n->scheduled.exchange(true))
+                schedule(n);
+
+            if (count) {
+                _processed += count;
+                if (_flushers.load()) {
+                    { std::lock_guard l(_m); }
+                    _cv_done.notify_all();
+                }
+            }
+            return count;
+        }
+
+        static bool pop_overflow(node *n, envelope &e) {
+            if (!n->overflowed.load()) return false;
+            std::lock_guard l(n->overflow_m);
+            if (n->overflow.empty()) return false;
+            e = std::move(n->overflow.front());
+            n->overflow.pop_front();
+            n->overflowed--;
+            return true;
+        }
+
+        void run() {
+            for (;;) {
+                if (poll(_batch * 16))
+                    continue;
+
+                std::unique_lock l(_m);
+                _idle++;
+                _cv_work.wait(l, [this] { return _ready.load() > 0 || _stopping.load(); });
+                _idle--;
+                if (_stopping.load() && _ready.load() == 0)
+                    break;
+            }
+        }
+
+        // the node being drained by this thread, if any
+        static node *&current() {
+            static thread_local node *n{};
+            return n;
+        }
+
+        static std::size_t round_up(std::size_t n) {
+            std::size_t r = 2;
+            while (r < n) r <<= 1;
+            return r;
+        }
+
+    private:
+        std::size_t const _mask;
+        std::unique_ptr<std::atomic<node *>[]> _buckets;
+        std::atomic<node *> _all{nullptr};
+        std::size_t const _mailbox_capacity;
+        std::size_t const _batch;
+        std::atomic<std::size_t> _size{0};
+
+        dp::util::mpmc_ring<node *> _run_queue;
+        std::atomic<std::int64_t> _ready{0};
+        std::atomic<int> _idle{0}, _flushers{0};
+        std::atomic<std::uint64_t> _posted{0}, _processed{0}, _dropped{0};
+        std::atomic<int> _inflight{0}; // the sends in progress
+        std::atomic<bool> _stopping{false};
+        bool _stopped{false};
+
+        std::mutex _wm{}; // serializes join()
+        std::mutex _m{};
+        std::condition_variable _cv_work{}, _cv_done{};
+        std::vector<std::thread> _workers{}; // keep it the last one, they start in the constructor
+    };
+
 } // namespace dp::mediator
 
 #endif //DESIGN_PATTERNS_CXX_DP_MEDIATOR_HH
@@ -11,61 +11,116 @@
 #ifndef DESIGN_PATTERNS_CXX_DP_MSG_DISPATCH_HH
 #define DESIGN_PATTERNS_CXX_DP_MSG_DISPATCH_HH
 
+#include "dp-common.hh"
+
 #include <type_traits>
 
+#include <algorithm>
+#include <functional>
 #include <memory>
 
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
 #include <optional>
+#include <tuple>
+#include <unordered_map>
 #include <vector>
 
 namespace dp::msg_disp {
 
     template<typename R, typename... Messages>
-    class message_bumper_t;
+    class controller_t;
 
     template<typename R, typename... Messages>
     class receiver_t;
 
+    /**
+     * @brief how a message is passed to a receiver which only looks at it.
+     */
+    template<typename M>
+    using msg_cref_t = std::decay_t<M> const &;
+    /**
+     * @brief how a message is passed to the receiver which may take it over.
+     */
+    template<typename M>
+    using msg_rref_t = std::decay_t<M> &&;
+
+    /**
+     * @brief sender_t posts the messages to its controller.
+     * @details send() takes the messages by const reference, or by rvalue
+     * reference when all of them are temporaries or moved in; only the
+     * latter lets the last receiver take the messages over.
+     */
     template<typename R, typename... Messages>
     class sender_t {
     public:
         virtual ~sender_t() {}
 
-        using ControllerT = message_bumper_t<R, Messages...>;
+        using ControllerT = controller_t<R, Messages...>;
         using ControllerPtr = ControllerT *;
         void controller(ControllerPtr sp) { _controller = sp; }
         ControllerPtr &controller() { return _controller; }
 
-        std::optional<R> send(Messages &&...msgs) { return on_send(std::forward<Messages>(msgs)...); }
+        std::optional<R> send(msg_cref_t<Messages>... msgs) { return on_send(msgs...); }
+        std::optional<R> send(msg_rref_t<Messages>... msgs) { return on_send(std::move(msgs)...); }
 
     protected:
-        virtual std::optional<R> on_send(Messages &&...msgs);
+        virtual std::optional<R> on_send(msg_cref_t<Messages>... msgs);
+        virtual std::optional<R> on_send(msg_rref_t<Messages>... msgs);
 
     private:
         ControllerPtr _controller{};
     };
 
+    /**
+     * @brief receiver_t gets the messages by const reference in on_recv().
+     * @details When a message is moved into the bumper, the last receiver
+     * it reaches gets it by rvalue reference in on_consume(), which may
+     * take the payload over. on_consume() defaults to on_recv().
+     */
     template<typename R, typename... Messages>
     class receiver_t {
     public:
         virtual ~receiver_t() {}
         using SenderT = sender_t<R, Messages...>;
-        std::optional<R> recv(SenderT *sender, Messages &&...msgs) { return on_recv(sender, std::forward<Messages>(msgs)...); }
+        std::optional<R> recv(SenderT *sender, msg_cref_t<Messages>... msgs) { return on_recv(sender, msgs...); }
+        std::optional<R> recv(SenderT *sender, msg_rref_t<Messages>... msgs) { return on_consume(sender, std::move(msgs)...); }
 
     protected:
-        virtual std::optional<R> on_recv(SenderT *sender, Messages &&...msgs) = 0;
+        virtual std::optional<R> on_recv(SenderT *sender, msg_cref_t<Messages>... msgs) = 0;
+        virtual std::optional<R> on_consume(SenderT *sender, msg_rref_t<Messages>... msgs) { return on_recv(sender, msgs...); }
+    };
+
+    /**
+     * @brief controller_t is what a sender_t posts its messages to.
+     * @details It promises nothing but delivery: how the receivers are
+     * picked and how their results are combined is up to each bumper,
+     * see message_bumper_t and async_message_bumper_t.
+     */
+    template<typename R, typename... Messages>
+    class controller_t {
+    public:
+        virtual ~controller_t() {}
+        using SenderT = sender_t<R, Messages...>;
+
+        virtual std::optional<R> send(SenderT *sender, msg_cref_t<Messages>... msgs) = 0;
+        virtual std::optional<R> send(SenderT *sender, msg_rref_t<Messages>... msgs) = 0;
     };
 
     template<typename Sender, typename Receivers, typename R, typename... Messages>
     class message_bumper_base_t {
     public:
-        using Self = message_bumper_base_t<R, Messages...>;
+        using Self = message_bumper_base_t<Sender, Receivers, R, Messages...>;
         using SenderT = Sender;
         using value_type = typename Receivers::value_type;
 
-        void add_receiver(value_type &&o) { _coll.emplace_back(o); }
+        void add_receiver(value_type const &o) { _coll.emplace_back(o); }
+        void add_receiver(value_type &&o) { _coll.emplace_back(std::move(o)); }
         template<class T, class... Args>
-        void add_receiver(Args &&...args) { _coll.emplace_back(std::make_shared<T>(args...)); }
+        void add_receiver(Args &&...args) { _coll.emplace_back(std::make_shared<T>(std::forward<Args>(args)...)); }
 
         // using Pred = std::function<bool(ReceiverSP &target, Messages &&...)>;
         // std::optional<R> send(Pred pred, Messages &&...msgs) {
@@ -80,10 +135,22 @@ namespace dp::msg_disp {
         //     return ret;
         // }
 
-        std::optional<R> send(SenderT *sender, Messages &&...msgs) {
+        std::optional<R> send(SenderT *sender, msg_cref_t<Messages>... msgs) {
             std::optional<R> ret;
             for (auto &c : _coll) {
-                ret = c->recv(sender, std::forward<Messages>(msgs)...);
+                ret = c->recv(sender, msgs...);
+                if (!ret.has_value())
+                    break;
+            }
+            return ret;
+        }
+
+        // the messages are moved into the last receiver only, the others see them by const&
+        std::optional<R> send(SenderT *sender, msg_rref_t<Messages>... msgs) {
+            std::optional<R> ret;
+            for (auto it = _coll.begin(), end = _coll.end(); it != end;) {
+                auto &c = *it++;
+                ret = it == end ? c->recv(sender, std::move(msgs)...) : c->recv(sender, msgs...);
                 if (!ret.has_value())
                     break;
             }
@@ -94,9 +161,14 @@ namespace dp::msg_disp {
         Receivers _coll;
     };
 
+    /**
+     * @brief message_bumper_t walks the receivers in their registration
+     * order, an empty result from a receiver stops the propagation.
+     */
     template<typename R, typename... Messages>
-    class message_bumper_t {
+    class message_bumper_t : public controller_t<R, Messages...> {
     public:
+        ~message_bumper_t() override {}
         using Self = message_bumper_t<R, Messages...>;
         using SenderT = sender_t<R, Messages...>;
         using ReceiverT = receiver_t<R, Messages...>;
@@ -104,21 +176,432 @@ namespace dp::msg_disp {
         using Receivers = std::vector<ReceiverSP>;
         using UT = message_bumper_base_t<SenderT, Receivers, R, Messages...>;
 
-        void add_receiver(typename UT::value_type &&o) { _ut.add_receiver(o); }
+        void add_receiver(typename UT::value_type const &o) { _ut.add_receiver(o); }
+        void add_receiver(typename UT::value_type &&o) { _ut.add_receiver(std::move(o)); }
         template<class T, class... Args>
-        void add_receiver(Args &&...args) { _ut.add_receiver(std::make_shared<T>(args...)); }
+        void add_receiver(Args &&...args) { _ut.add_receiver(std::make_shared<T>(std::forward<Args>(args)...)); }
 
-        std::optional<R> send(SenderT *sender, Messages &&...msgs) {
-            return _ut.send(sender, std::forward<Messages>(msgs)...);
+        std::optional<R> send(SenderT *sender, msg_cref_t<Messages>... msgs) override {
+            return _ut.send(sender, msgs...);
+        }
+        std::optional<R> send(SenderT *sender, msg_rref_t<Messages>... msgs) override {
+            return _ut.send(sender, std::move(msgs)...);
         }
 
     private:
         UT _ut{};
     };
 
+    /**
+     * @brief indexed_message_bumper_t routes a message to the receivers
+     * interested in its key only.
+     *
+     * The key of a message is computed by the extractor given at
+     * construction. Each receiver registers for one key (or for all keys,
+     * as a wildcard receiver) with a priority; higher priorities receive
+     * first, equal priorities keep their registration order.
+     *
+     * The index maps a key to its receiver list with the wildcard
+     * receivers already merged in and sorted, so send() does one hash
+     * lookup and then walks just the interested receivers. A message
+     * whose key has no list goes to the wildcard receivers. As in
+     * message_bumper_t, an empty result from a receiver stops the
+     * propagation. It isn't a message_bumper_t though: a receiver
+     * added without a key would never be reached.
+     *
+     * Registration is not thread-safe against send().
+     *
+     * @tparam Key  the key type, hashable by std::hash<Key>
+     * @tparam R
+     * @tparam Messages
+     */
+    template<typename Key, typename R, typename... Messages>
+    class indexed_message_bumper_t : public controller_t<R, Messages...> {
+    public:
+        using Self = indexed_message_bumper_t<Key, R, Messages...>;
+        using SenderT = sender_t<R, Messages...>;
+        using ReceiverT = receiver_t<R, Messages...>;
+        using ReceiverSP = std::shared_ptr<ReceiverT>;
+        using key_type = Key;
+        using KeyExtractor = std::function<Key(std::decay_t<Messages> const &...)>;
+
+        explicit indexed_message_bumper_t(KeyExtractor extractor)
+            : _key_of(std::move(extractor)) {}
+        ~indexed_message_bumper_t() override {}
+
+        /** @brief add_receiver registers a receiver for messages keyed by \a key. */
+        void add_receiver(Key const &key, ReceiverSP const &o, int priority = 0) {
+            auto it = _index.find(key);
+            if (it == _index.end())
+                it = _index.emplace(key, _wildcards).first;
+            insert(it->second, entry{priority, _seq++, o});
+        }
+        template<class T, class... Args>
+        void add_receiver(Key const &key, int priority, Args &&...args) {
+            add_receiver(key, std::make_shared<T>(std::forward<Args>(args)...), priority);
+        }
+
+        /** @brief add_wildcard_receiver registers a receiver for every key. */
+        void add_wildcard_receiver(ReceiverSP const &o, int priority = 0) {
+            entry e{priority, _seq++, o};
+            insert(_wildcards, e);
+            for (auto &[k, list] : _index)
+                insert(list, e);
+        }
+        template<class T, class... Args>
+        void add_wildcard_receiver(int priority, Args &&...args) {
+            add_wildcard_receiver(std::make_shared<T>(std::forward<Args>(args)...), priority);
+        }
+
+        /** @brief remove_receiver unregisters \a o from every key it was added to. */
+        void remove_receiver(ReceiverSP const &o) {
+            auto pred = [&o](entry const &e) { return e.receiver == o; };
+            _wildcards.erase(std::remove_if(_wildcards.begin(), _wildcards.end(), pred), _wildcards.end());
+            for (auto it = _index.begin(); it != _index.end();) {
+                auto &list = it->second;
+                list.erase(std::remove_if(list.begin(), list.end(), pred), list.end());
+                if (list.empty())
+                    it = _index.erase(it);
+                else
+                    ++it;
+            }
+        }
+
+        std::optional<R> send(SenderT *sender, msg_cref_t<Messages>... msgs) override {
+            std::optional<R> ret;
+            for (auto const &e : receivers_of(msgs...)) {
+                ret = e.receiver->recv(sender, msgs...);
+                if (!ret.has_value())
+                    break;
+            }
+            return ret;
+        }
+        std::optional<R> send(SenderT *sender, msg_rref_t<Messages>... msgs) override {
+            std::optional<R> ret;
+            auto const &list = receivers_of(msgs...);
+            for (auto it = list.begin(), end = list.end(); it != end;) {
+                auto const &e = *it++;
+                ret = it == end ? e.receiver->recv(sender, std::move(msgs)...) : e.receiver->recv(sender, msgs...);
+                if (!ret.has_value())
+                    break;
+            }
+            return ret;
+        }
+
+        std::size_t receivers(Key const &key) const {
+            auto it = _index.find(key);
+            return it == _index.end() ? _wildcards.size() : it->second.size();
+        }
+
+    private:
+        struct entry {
+            int priority;
+            std::size_t seq;
+            ReceiverSP receiver;
+        };
+        using list_t = std::vector<entry>;
+
+        list_t const &receivers_of(msg_cref_t<Messages>... msgs) const {
+            auto it = _index.find(_key_of(msgs...));
+            return it == _index.end() ? _wildcards : it->second;
+        }
+
+        static void insert(list_t &list, entry const &e) {
+            auto pos = std::upper_bound(list.begin(), list.end(), e, [](entry const &a, entry const &b) {
+                return a.priority != b.priority ? a.priority > b.priority : a.seq < b.seq;
+            });
+            list.insert(pos, e);
+        }
+
+    private:
+        KeyExtractor _key_of;
+        std::unordered_map<Key, list_t> _index{};
+        list_t _wildcards{};
+        std::size_t _seq{};
+    };
+
+    /**
+     * @brief reply_t collects the results of an async_message_bumper_t::post().
+     * @details The receivers complete in any order; results() lists
+     * their results in the registration order of the receivers.
+     */
+    template<typename R>
+    class reply_t {
+    public:
+        reply_t() = default;
+
+        /** @brief ready tells whether every receiver has returned. */
+        bool ready() const { return !_st || _st->remaining.load(std::memory_order_acquire) == 0; }
+        void wait() const {
+            if (ready()) return;
+            std::unique_lock l(_st->m);
+            _st->cv.wait(l, [this] { return ready(); });
+        }
+
+        /**
+         * @brief get waits for the receivers and combines their results.
+         * @return empty if there is no receiver or any of them returned
+         * empty (the asynchronous counterpart of stopping the
+         * propagation), else the result of the last receiver.
+         */
+        std::optional<R> get() const {
+            wait();
+            if (!_st || _st->results.empty()) return {};
+            for (auto const &r : _st->results)
+                if (!r.has_value()) return {};
+            return _st->results.back();
+        }
+
+        std::vector<std::optional<R>> const &results() const {
+            static std::vector<std::optional<R>> const none{};
+            wait();
+            return _st ? _st->results : none;
+        }
+
+    private:
+        template<typename, typename...>
+        friend class async_message_bumper_t;
+
+        struct state {
+            explicit state(std::size_t n)
+                : remaining(n)
+                , results(n) {}
+            void complete(std::size_t slot, std::optional<R> &&r) {
+                results[slot] = std::move(r);
+                if (remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                    { std::lock_guard l(m); }
+                    cv.notify_all();
+                }
+            }
+            std::atomic<std::size_t> remaining;
+            std::vector<std::optional<R>> results;
+            std::mutex m{};
+            std::condition_variable cv{};
+        };
+
+        explicit reply_t(std::shared_ptr<state> st)
+            : _st(std::move(st)) {}
+
+        std::shared_ptr<state> _st{};
+    };
+
+    /**
+     * @brief async_message_bumper_t delivers the messages on a pool of
+     * worker threads.
+     *
+     * The pool is split into shards, each one owns a worker and a
+     * lock-free mailbox (dp::util::mpmc_ring). A receiver is pinned to
+     * one shard when it is added, so it always runs on the same worker
+     * and sees the messages of a sender in the order they were posted;
+     * different receivers run in parallel.
+     *
+     * post() enqueues the messages for every receiver and returns a
+     * reply_t at once. send() posts and waits, so the senders work with
+     * it through their controller pointer, but it must not be called
+     * from a receiver of the same bumper. Unlike message_bumper_t, every
+     * receiver gets the messages, an empty result only empties the
+     * combined one (see reply_t::get()); so it's a controller_t but not
+     * a message_bumper_t.
+     *
+     * The messages are copied or moved into one envelope per post and
+     * every receiver reads them by const reference, so they must be
+     * copy-constructible. Receivers should be added before the messages
+     * start flowing. After stop() the posts are answered by empty
+     * results. A post waits for room while a mailbox is full, it's
+     * answered by an empty result too if the bumper is stopped meanwhile.
+     *
+     * @code{c++}
+     * dp::msg_disp::async_message_bumper_t&lt;R, std::string&gt; m{4};
+     * m.add_receiver&lt;B&gt;("b1");
+     * auto reply = m.post(nullptr, "hello");
+     * auto r = reply.get();
+     * @endcode
+     */
+    template<typename R, typename... Messages>
+    class async_message_bumper_t : public controller_t<R, Messages...> {
+    public:
+        using Self = async_message_bumper_t<R, Messages...>;
+        using SenderT = sender_t<R, Messages...>;
+        using ReceiverT = receiver_t<R, Messages...>;
+        using ReceiverSP = std::shared_ptr<ReceiverT>;
+        using reply_type = reply_t<R>;
+
+        explicit async_message_bumper_t(std::size_t shards = 0, std::size_t mailbox_capacity = 1024) {
+            if (shards == 0)
+                shards = std::max(1u, std::thread::hardware_concurrency());
+            _shards.reserve(shards);
+            for (std::size_t i = 0; i < shards; i++)
+                _shards.emplace_back(std::make_unique<shard>(mailbox_capacity));
+        }
+        ~async_message_bumper_t() override { stop(); }
+
+        /** @brief add_receiver pins \a o to the next shard in a round-robin way. */
+        void add_receiver(ReceiverSP const &o) { add_receiver(o, _receivers.size() % _shards.size()); }
+        /** @brief add_receiver pins \a o to the given shard. */
+        void add_receiver(ReceiverSP const &o, std::size_t shard_index) {
+            _receivers.push_back({o, shard_index % _shards.size()});
+        }
+        template<class T, class... Args>
+        void add_receiver(Args &&...args) { add_receiver(std::make_shared<T>(std::forward<Args>(args)...)); }
+
+        std::size_t shards() const { return _shards.size(); }
+
+        reply_type post(SenderT *sender, msg_cref_t<Messages>... msgs) { return post_envelope(sender, msgs...); }
+        reply_type post(SenderT *sender, msg_rref_t<Messages>... msgs) { return post_envelope(sender, std::move(msgs)...); }
+
+        std::optional<R> send(SenderT *sender, msg_cref_t<Messages>... msgs) override {
+            return post(sender, msgs...).get();
+        }
+        std::optional<R> send(SenderT *sender, msg_rref_t<Messages>... msgs) override {
+            return post(sender, std::move(msgs)...).get();
+        }
+
+        /** @brief stop drains the mailboxes and joins the workers. */
+        void stop() {
+            for (auto &sh : _shards)
+                sh->stop();
+        }
+
+    private:
+        template<typename... Args>
+        reply_type post_envelope(SenderT *sender, Args &&...msgs) {
+            auto st = std::make_shared<typename reply_type::state>(_receivers.size());
+            if (!_receivers.empty()) {
+                auto env = std::make_shared<envelope>(envelope{sender, {std::forward<Args>(msgs)...}, st});
+                for (std::size_t i = 0; i < _receivers.size(); i++) {
+                    auto &rc = _receivers[i];
+                    if (!_shards[rc.shard]->push(task{rc.receiver.get(), i, env}))
+                        st->complete(i, {});
+                }
+            }
+            return reply_type{std::move(st)};
+        }
+
+        struct envelope {
+            SenderT *sender;
+            std::tuple<std::decay_t<Messages>...> msgs;
+            std::shared_ptr<typename reply_type::state> st;
+        };
+
+        struct task {
+            ReceiverT *receiver{};
+            std::size_t slot{};
+            std::shared_ptr<envelope> env{};
+
+            void operator()() {
+                // the receivers may run at the same time, they share the messages by const&
+                auto r = std::apply([this](auto const &...m) { return receiver->recv(env->sender, m...); }, env->msgs);
+                env->st->complete(slot, std::move(r));
+            }
+        };
+
+        class shard {
+        public:
+            explicit shard(std::size_t capacity)
+                : _mailbox(capacity)
+                , _worker([this] { run(); }) {}
+
+            bool push(task &&t) {
+                // reserve first: the worker doesn't exit while _enqueued is ahead of _done,
+                // so once _stopping is seen clear here the task will be run
+                _enqueued++;
+                if (_stopping.load())
+                    return cancel();
+                while (!_mailbox.try_push(std::move(t))) {
+                    wake();
+                    std::unique_lock l(_m);
+                    if (_stopping.load()) {
+                        l.unlock();
+                        return cancel();
+                    }
+                    _waiting_room++;
+                    std::atomic_thread_fence(std::memory_order_seq_cst); // pairs with the one in run()
+                    _cv_room.wait(l, [this] { return _mailbox.size() < _mailbox.capacity() || _stopping.load(); });
+                    _waiting_room--;
+                }
+                wake();
+                return true;
+            }
+
+            void stop() {
+                {
+                    std::lock_guard l(_m);
+                    if (_stopping.exchange(true)) return;
+                }
+                _cv.notify_one();
+                _cv_room.notify_all();
+                if (_worker.joinable())
+                    _worker.join();
+            }
+
+        private:
+            bool cancel() {
+                _enqueued--;
+                {
+                    std::lock_guard l(_m);
+                }
+                _cv.notify_one();
+                return false;
+            }
+
+            void wake() {
+                if (_sleeping.load()) {
+                    { std::lock_guard l(_m); }
+                    _cv.notify_one();
+                }
+            }
+
+            void run() {
+                for (;;) {
+                    task t{};
+                    if (_mailbox.try_pop(t)) {
+                        std::atomic_thread_fence(std::memory_order_seq_cst);
+                        if (_waiting_room.load()) {
+                            { std::lock_guard l(_m); }
+                            _cv_room.notify_one();
+                        }
+                        t();
+                        _done++;
+                        continue;
+                    }
+
+                    std::unique_lock l(_m);
+                    _sleeping = true;
+                    _cv.wait(l, [this] { return _enqueued.load() != _done.load() || _stopping.load(); });
+                    _sleeping = false;
+                    if (_stopping.load() && _enqueued.load() == _done.load())
+                        break;
+                }
+            }
+
+        private:
+            dp::util::mpmc_ring<task> _mailbox;
+            std::atomic<std::uint64_t> _enqueued{0}, _done{0};
+            std::atomic<bool> _stopping{false}, _sleeping{false};
+            std::atomic<int> _waiting_room{0};
+            std::mutex _m{};
+            std::condition_variable _cv{}, _cv_room{};
+            std::thread _worker; // keep it the last one, it starts in the constructor
+        };
+
+        struct pinned {
+            ReceiverSP receiver;
+            std::size_t shard;
+        };
+
+    private:
+        std::vector<pinned> _receivers{};
+        std::vector<std::unique_ptr<shard>> _shards{};
+    };
+
+    template<typename R, typename... Messages>
+    inline std::optional<R> sender_t<R, Messages...>::on_send(msg_cref_t<Messages>... msgs) {
+        return controller()->send(this, msgs...);
+    }
+
     template<typename R, typename... Messages>
-    inline std::optional<R> sender_t<R, Messages...>::on_send(Messages &&...msgs) {
-        return controller()->send(this, std::forward<Messages>(msgs)...);
+    inline std::optional<R> sender_t<R, Messages...>::on_send(msg_rref_t<Messages>... msgs) {
+        return controller()->send(this, std::move(msgs)...);
     }
 
 } // namespace dp::msg_disp
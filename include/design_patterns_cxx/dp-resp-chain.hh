@@ -8,14 +8,19 @@
 // Created by Hedzr Yeh on 2021/10/20.
 //
 
-#ifndef DESIGN_PATTERNS_CXX_DP_MEDIATOR_HH
-#define DESIGN_PATTERNS_CXX_DP_MEDIATOR_HH
+#ifndef DESIGN_PATTERNS_CXX_DP_RESP_CHAIN_HH
+#define DESIGN_PATTERNS_CXX_DP_RESP_CHAIN_HH
 
 #include <type_traits>
 
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
 #include <memory>
 
 #include <optional>
+#include <tuple>
+#include <utility>
 #include <vector>
 
 namespace dp::resp_chain {
@@ -56,6 +61,33 @@ namespace dp::resp_chain {
         virtual std::optional<R> on_recv(SenderT *sender, Messages &&...msgs) = 0;
     };
 
+    /**
+     * @brief the counters of a handler in message_chain_t.
+     */
+    struct handler_stats {
+        std::uint64_t invocations{}; //!< how many times the handler was called.
+        std::uint64_t stops{};       //!< how many times it returned empty and stopped the chain.
+        std::uint64_t ns{};          //!< the cumulative time spent in it, in nanoseconds.
+    };
+
+    /**
+     * @brief message_chain_t passes a message along its handlers until
+     * one of them returns an empty optional.
+     *
+     * enable_statistics() turns on the per-handler counters, see stats().
+     *
+     * enable_adaptive() turns them on too, and every \a period sends it
+     * reorders the handlers added as independent so that the ones which
+     * stop the chain most often for the least time run first. Only the
+     * adjacent independent handlers are reordered among themselves, a
+     * handler added as dependent (the default) keeps its position and
+     * splits the chain. The reordering uses the counters of the recent
+     * sends only (they decay by half at each pass), so it follows a
+     * changing traffic.
+     *
+     * The counters are not atomic: with statistics on, send() must not be
+     * called concurrently.
+     */
     template<typename R, typename... Messages>
     class message_chain_t {
     public:
@@ -65,22 +97,97 @@ namespace dp::resp_chain {
         using ReceiverSP = std::shared_ptr<ReceiverT>;
         using Receivers = std::vector<ReceiverSP>;
 
-        void add_receiver(ReceiverSP &&o) { _coll.emplace_back(o); }
+        void add_receiver(ReceiverSP &&o, bool independent = false) { _coll.push_back(entry{std::move(o), independent}); }
+        template<class T, class... Args>
+        void add_receiver(Args &&...args) { add_receiver(std::make_shared<T>(std::forward<Args>(args)...)); }
+        /** @brief add_independent_receiver adds a handler which may be reordered by the adaptive mode. */
         template<class T, class... Args>
-        void add_receiver(Args &&...args) { _coll.emplace_back(std::make_shared<T>(args...)); }
+        void add_independent_receiver(Args &&...args) { add_receiver(std::make_shared<T>(std::forward<Args>(args)...), true); }
 
         std::optional<R> send(SenderT *sender, Messages &&...msgs) {
             std::optional<R> ret;
+            if (!_statistics) {
+                for (auto &c : _coll) {
+                    ret = c.receiver->recv(sender, std::forward<Messages>(msgs)...);
+                    if (!ret.has_value())
+                        break;
+                }
+                return ret;
+            }
+
             for (auto &c : _coll) {
-                ret = c->recv(sender, std::forward<Messages>(msgs)...);
-                if (!ret.has_value())
+                auto begin = clock::now();
+                ret = c.receiver->recv(sender, std::forward<Messages>(msgs)...);
+                auto ns = (std::uint64_t) std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - begin).count();
+                c.total.invocations++, c.recent.invocations++;
+                c.total.ns += ns, c.recent.ns += ns;
+                if (!ret.has_value()) {
+                    c.total.stops++, c.recent.stops++;
                     break;
+                }
+            }
+            if (_period && ++_sends >= _period) {
+                _sends = 0;
+                reorder();
             }
             return ret;
         }
 
+    public:
+        void enable_statistics(bool b = true) {
+            _statistics = b || _period;
+        }
+        /** @brief enable_adaptive reorders the independent handlers every \a period sends, 0 to disable. */
+        void enable_adaptive(std::size_t period = 1024) {
+            _period = period;
+            _sends = 0;
+            if (period) _statistics = true;
+        }
+        void reset_statistics() {
+            for (auto &c : _coll) c.total = c.recent = handler_stats{};
+        }
+
+        std::size_t size() const { return _coll.size(); }
+        /** @brief receiver returns the i-th handler in the current order. */
+        ReceiverSP const &receiver(std::size_t i) const { return _coll[i].receiver; }
+        handler_stats const &stats(std::size_t i) const { return _coll[i].total; }
+
     protected:
-        Receivers _coll;
+        struct entry {
+            ReceiverSP receiver;
+            bool independent{};
+            handler_stats total{};
+            handler_stats recent{};
+        };
+
+        // For the independent filters, the expected cost of a chain is the
+        // least when they are sorted by stop rate / cost, i.e. by stops / ns.
+        void reorder() {
+            auto score = [](entry const &e) {
+                return e.recent.invocations ? double(e.recent.stops) / double(e.recent.ns + 1) : -1.0;
+            };
+            for (auto it = _coll.begin(); it != _coll.end();) {
+                if (!it->independent) {
+                    ++it;
+                    continue;
+                }
+                auto last = std::find_if(it, _coll.end(), [](entry const &e) { return !e.independent; });
+                std::stable_sort(it, last, [&score](entry const &a, entry const &b) { return score(a) > score(b); });
+                it = last;
+            }
+            for (auto &c : _coll) {
+                c.recent.invocations /= 2;
+                c.recent.stops /= 2;
+                c.recent.ns /= 2;
+            }
+        }
+
+    protected:
+        using clock = std::chrono::steady_clock;
+        std::vector<entry> _coll;
+        bool _statistics{};
+        std::size_t _period{};
+        std::size_t _sends{};
     };
 
     template<typename R, typename... Messages>
@@ -88,6 +195,71 @@ namespace dp::resp_chain {
         return controller()->send(this, std::forward<Messages>(msgs)...);
     }
 
-} // namespace dp::mediator
+    /**
+     * @brief static_chain is a responsibility chain fixed at compile time.
+     *
+     * Each handler is a callable type which takes the messages (by const
+     * reference or by value) and returns a std::optional<R>. The handlers
+     * are kept by value in a tuple and called in order by a fold
+     * expression, so the whole chain inlines into send() without virtual
+     * calls, shared_ptr or heap. As message_chain_t::send(), it stops at
+     * the first handler returning an empty optional and returns the last
+     * result.
+     *
+     * @code{c++}
+     * struct auth { std::optional&lt;int&gt; operator()(request const &r) const; };
+     * struct quota { std::optional&lt;int&gt; operator()(request const &r) const; };
+     * dp::resp_chain::static_chain&lt;auth, quota&gt; chain;
+     * auto ret = chain.send(req);
+     *
+     * // or from lambdas
+     * dp::resp_chain::static_chain c2{[](request const &) -&gt; std::optional&lt;int&gt; { return 0; }};
+     * @endcode
+     */
+    template<typename... Handlers>
+    class static_chain {
+    public:
+        static_assert(sizeof...(Handlers) > 0, "static_chain needs one handler at least");
+        using Self = static_chain<Handlers...>;
+        using handlers_t = std::tuple<Handlers...>;
+
+        static_chain() = default;
+        explicit static_chain(Handlers... handlers)
+            : _handlers(std::move(handlers)...) {}
+
+        template<typename... Messages>
+        auto send(Messages const &...msgs) {
+            using R = std::invoke_result_t<std::tuple_element_t<0, handlers_t> &, Messages const &...>;
+            R ret{};
+            std::apply([&ret, &msgs...](auto &...h) { (void) ((ret = h(msgs...)).has_value() && ...); }, _handlers);
+            return ret;
+        }
+        template<typename... Messages>
+        auto operator()(Messages const &...msgs) { return send(msgs...); }
+
+        template<std::size_t I>
+        auto &get() { return std::get<I>(_handlers); }
+        static constexpr std::size_t size() { return sizeof...(Handlers); }
+
+    private:
+        handlers_t _handlers{};
+    };
+
+    /**
+     * @brief static_chain_of builds a static_chain from a type list, such
+     * as dp::traits::typelist&lt;H1, H2&gt; or std::tuple&lt;H1, H2&gt;.
+     */
+    template<typename TypeList>
+    struct static_chain_of;
+
+    template<template<typename...> class List, typename... Handlers>
+    struct static_chain_of<List<Handlers...>> {
+        using type = static_chain<Handlers...>;
+    };
+
+    template<typename TypeList>
+    using static_chain_of_t = typename static_chain_of<TypeList>::type;
+
+} // namespace dp::resp_chain
 
-#endif //DESIGN_PATTERNS_CXX_DP_MEDIATOR_HH
+#endif //DESIGN_PATTERNS_CXX_DP_RESP_CHAIN_HH
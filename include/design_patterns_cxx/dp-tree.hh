@@ -12,7 +12,9 @@
 #define DESIGN_PATTERNS_CXX_DP_TREE_HH
 
 #include <cstddef>
+#include <cstdint>
 #include <cstring>
+#include <exception>
 
 #include <deque>
 #include <queue>
@@ -20,95 +22,317 @@
 #include <vector>
 
 #include <algorithm>
+#include <atomic>
+#include <condition_variable>
 #include <functional>
 #include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
 
 #include <cassert>
 
 #include <iterator>
+#include <type_traits>
+#include <utility>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 namespace dp::tree::detail {
 
+  /**
+   * @brief the orders in which the binary tree iterators walk.
+   */
+  enum class traversal {
+    in_order,
+    pre_order,
+    post_order,
+  };
+
+  /**
+   * @brief a forward iterator over the nodes of a binary (sub)tree.
+   * @details It climbs back by the parent pointers, so it holds two
+   * pointers and allocates nothing. The walk stays inside the subtree
+   * it started from.
+   */
+  template<typename Node, traversal Order>
+  class node_iterator {
+  public:
+    using difference_type = std::ptrdiff_t;
+    using value_type = Node;
+    using pointer = value_type *;
+    using reference = value_type &;
+    using iterator_category = std::forward_iterator_tag;
+    using self = node_iterator;
+
+    node_iterator() {}
+    node_iterator(pointer ptr_, pointer root_)
+        : _ptr(ptr_)
+        , _root(root_) {}
+
+    static self begin(pointer root_) {
+      if (!root_) return self{};
+      if constexpr (Order == traversal::in_order)
+        return self{leftmost(root_), root_};
+      else if constexpr (Order == traversal::post_order)
+        return self{first_post_order(root_), root_};
+      else
+        return self{root_, root_};
+    }
+    static self end(pointer root_) { return self{nullptr, root_}; }
+
+    bool operator==(self const &r) const { return _ptr == r._ptr; }
+    bool operator!=(self const &r) const { return _ptr != r._ptr; }
+    reference operator*() const { return *_ptr; }
+    pointer operator->() const { return _ptr; }
+    pointer get() const { return _ptr; }
+    self &operator++() {
+      _ptr = next(_ptr);
+      return *this;
+    }
+    self operator++(int) {
+      self copy{*this};
+      ++(*this);
+      return copy;
+    }
+
+  private:
+    static pointer leftmost(pointer p) {
+      while (p->left) p = p->left;
+      return p;
+    }
+    static pointer first_post_order(pointer p) {
+      for (;;) {
+        if (p->left)
+          p = p->left;
+        else if (p->right)
+          p = p->right;
+        else
+          return p;
+      }
+    }
+
+    pointer next(pointer p) const {
+      if constexpr (Order == traversal::in_order) {
+        if (p->right) return leftmost(p->right);
+        for (; p != _root; p = p->parent)
+          if (p->parent->left == p) return p->parent;
+        return nullptr;
+      } else if constexpr (Order == traversal::pre_order) {
+        if (p->left) return p->left;
+        if (p->right) return p->right;
+        for (; p != _root; p = p->parent)
+          if (p->parent->left == p && p->parent->right) return p->parent->right;
+        return nullptr;
+      } else {
+        if (p == _root) return nullptr;
+        auto *parent = p->parent;
+        if (parent->left == p && parent->right) return first_post_order(parent->right);
+        return parent;
+      }
+    }
+
+    pointer _ptr{};
+    pointer _root{};
+  };
+
+  /**
+   * @brief a forward iterator over the nodes of a binary (sub)tree in
+   * level order.
+   * @details It keeps the frontier in a vector, which is copied along
+   * with the iterator.
+   */
+  template<typename Node>
+  class level_order_iterator {
+  public:
+    using difference_type = std::ptrdiff_t;
+    using value_type = Node;
+    using pointer = value_type *;
+    using reference = value_type &;
+    using iterator_category = std::forward_iterator_tag;
+    using self = level_order_iterator;
+
+    level_order_iterator() {}
+    explicit level_order_iterator(pointer root_) {
+      if (root_) _queue.push_back(root_);
+    }
+
+    static self begin(pointer root_) { return self{root_}; }
+    static self end(pointer) { return self{}; }
+
+    bool operator==(self const &r) const { return get() == r.get(); }
+    bool operator!=(self const &r) const { return get() != r.get(); }
+    reference operator*() const { return *get(); }
+    pointer operator->() const { return get(); }
+    pointer get() const { return _head < _queue.size() ? _queue[_head] : nullptr; }
+    self &operator++() {
+      auto *p = _queue[_head++];
+      if (p->left) _queue.push_back(p->left);
+      if (p->right) _queue.push_back(p->right);
+      return *this;
+    }
+    self operator++(int) {
+      self copy{*this};
+      ++(*this);
+      return copy;
+    }
+
+  private:
+    std::vector<pointer> _queue{};
+    std::size_t _head{};
+  };
+
+  /**
+   * @brief a pair of iterators usable by a range-based for.
+   */
+  template<typename Iterator>
+  struct node_range {
+    Iterator _begin, _end;
+    Iterator begin() const { return _begin; }
+    Iterator end() const { return _end; }
+  };
+
   template<typename Node>
   class tree_ops {
   public:
     using size_type = std::size_t;
     using NodePtr = Node *;
 
+    using in_order_iterator = node_iterator<Node, traversal::in_order>;
+    using pre_order_iterator = node_iterator<Node, traversal::pre_order>;
+    using post_order_iterator = node_iterator<Node, traversal::post_order>;
+    using level_order_iterator = detail::level_order_iterator<Node>;
+
   protected:
     size_type calc_height(NodePtr node) const {
-      if (node == nullptr)
-        return 0;
-      int left_side;
-      int right_side;
-      left_side = calc_height(node->left);
-      right_side = calc_height(node->right);
-      return (left_side > right_side) ? left_side + 1 : right_side + 1;
+      size_type h{};
+      traverse_levels(node, [&h](NodePtr, size_type level) { h = level + 1; });
+      return h;
     }
     size_type calc_count(NodePtr node) const {
-      if (node == nullptr)
-        return 0;
-      size_type n{1};
-      n += calc_count(node->left);
-      n += calc_count(node->right);
+      size_type n{};
+      traverse_pre_order(node, [&n](NodePtr) { n++; });
       return n;
     }
 
+    // a visitor may return false to stop the traversal
+    template<typename F>
+    static bool visit(F &fn, NodePtr node) {
+      if constexpr (std::is_convertible_v<std::invoke_result_t<F &, NodePtr>, bool>)
+        return fn(node);
+      else {
+        fn(node);
+        return true;
+      }
+    }
+
   public:
-    // Depth First Traversals
-    void traverse_in_order(NodePtr node, std::function<void(NodePtr)> &&fn) {
-      if (node == nullptr)
-        return;
+    // The traversals below are iterative: the depth first ones keep an
+    // explicit stack of at most the height of the tree, the breadth
+    // first one a single queue. The visitor is called with each node; it
+    // may return a bool, false to stop.
 
-      traverse_in_order(node->left, std::move(fn));
-      fn(node);
-      traverse_in_order(node->right, std::move(fn));
+    // Depth First Traversals
+    template<typename F>
+    void traverse_in_order(NodePtr node, F &&fn) const {
+      std::vector<NodePtr> stack;
+      while (node || !stack.empty()) {
+        for (; node; node = node->left)
+          stack.push_back(node);
+        node = stack.back();
+        stack.pop_back();
+        if (!visit(fn, node))
+          return;
+        node = node->right;
+      }
     }
     // Depth First Traversals
-    void traverse_in_order_rev(NodePtr node, std::function<void(NodePtr)> &&fn) {
-      if (node == nullptr)
-        return;
-
-      traverse_in_order(node->right, std::move(fn));
-      fn(node);
-      traverse_in_order(node->left, std::move(fn));
+    template<typename F>
+    void traverse_in_order_rev(NodePtr node, F &&fn) const {
+      std::vector<NodePtr> stack;
+      while (node || !stack.empty()) {
+        for (; node; node = node->right)
+          stack.push_back(node);
+        node = stack.back();
+        stack.pop_back();
+        if (!visit(fn, node))
+          return;
+        node = node->left;
+      }
     }
     // Depth First Traversals
-    void traverse_pre_order(NodePtr node, std::function<void(NodePtr)> &&fn) {
+    template<typename F>
+    void traverse_pre_order(NodePtr node, F &&fn) const {
       if (node == nullptr)
         return;
-
-      fn(node);
-      traverse_pre_order(node->left, std::move(fn));
-      traverse_pre_order(node->right, std::move(fn));
+      std::vector<NodePtr> stack{node};
+      while (!stack.empty()) {
+        node = stack.back();
+        stack.pop_back();
+        if (!visit(fn, node))
+          return;
+        if (node->right) stack.push_back(node->right);
+        if (node->left) stack.push_back(node->left);
+      }
     }
     // Depth First Traversals
-    void traverse_post_order(NodePtr node, std::function<void(NodePtr)> &&fn) {
-      if (node == nullptr)
-        return;
-
-      traverse_post_order(node->left, std::move(fn));
-      traverse_post_order(node->right, std::move(fn));
-      fn(node);
+    template<typename F>
+    void traverse_post_order(NodePtr node, F &&fn) const {
+      std::vector<NodePtr> stack;
+      NodePtr last{nullptr};
+      while (node || !stack.empty()) {
+        if (node) {
+          stack.push_back(node);
+          node = node->left;
+          continue;
+        }
+        auto *top = stack.back();
+        if (top->right && top->right != last) {
+          node = top->right;
+        } else {
+          if (!visit(fn, top))
+            return;
+          last = top;
+          stack.pop_back();
+        }
+      }
     }
     // Breadth First Traversals
-    void traverse_level_order(NodePtr node, std::function<void(NodePtr)> &&fn) {
-      for (int h = calc_height(node), i = 1; i <= h; i++)
-        traverse_current_level(node, i, std::move(fn));
+    template<typename F>
+    void traverse_level_order(NodePtr node, F &&fn) const {
+      traverse_levels(node, [&fn](NodePtr n, size_type) { return visit(fn, n); });
     }
-
-  protected:
-    void traverse_current_level(NodePtr node, int level, std::function<void(NodePtr)> &&fn) {
+    /**
+     * @brief traverse_levels walks the tree level by level in one pass,
+     * calling \a fn(node, level) with the root at level 0.
+     */
+    template<typename F>
+    void traverse_levels(NodePtr node, F &&fn) const {
       if (node == nullptr)
         return;
-      if (level == 1)
-        fn(node);
-      else if (level > 1) {
-        traverse_current_level(node->left, level - 1, std::move(fn));
-        traverse_current_level(node->right, level - 1, std::move(fn));
+      std::vector<NodePtr> queue{node};
+      for (size_type level = 0, head = 0; head < queue.size(); level++) {
+        for (size_type tail = queue.size(); head < tail; head++) {
+          auto *p = queue[head];
+          if constexpr (std::is_convertible_v<std::invoke_result_t<F &, NodePtr, size_type>, bool>) {
+            if (!fn(p, level))
+              return;
+          } else {
+            fn(p, level);
+          }
+          if (p->left) queue.push_back(p->left);
+          if (p->right) queue.push_back(p->right);
+        }
       }
     }
+
+    // the iterators, they climb back by the parent pointers
+    static node_range<in_order_iterator> in_order(NodePtr node) { return {in_order_iterator::begin(node), in_order_iterator::end(node)}; }
+    static node_range<pre_order_iterator> pre_order(NodePtr node) { return {pre_order_iterator::begin(node), pre_order_iterator::end(node)}; }
+    static node_range<post_order_iterator> post_order(NodePtr node) { return {post_order_iterator::begin(node), post_order_iterator::end(node)}; }
+    static node_range<level_order_iterator> level_order(NodePtr node) { return {level_order_iterator::begin(node), level_order_iterator::end(node)}; }
   };
 
   template<typename Data>
@@ -118,124 +342,816 @@ namespace dp::tree::detail {
     rb_node_t *left{};
     rb_node_t *right{};
     rb_node_t *parent{};
+  };
+
+  /**
+   * @brief rb_os_node_t is a red-black node which also keeps the size of
+   * its subtree, so the tree answers the order statistics queries.
+   */
+  template<typename Data>
+  struct rb_os_node_t {
+    Data key{};
+    bool color_is_red{};
+    rb_os_node_t *left{};
+    rb_os_node_t *right{};
+    rb_os_node_t *parent{};
+    std::size_t size{1};
+  };
+
+  template<typename Node, typename = void>
+  struct has_subtree_size : std::false_type {};
+  template<typename Node>
+  struct has_subtree_size<Node, std::void_t<decltype(std::declval<Node &>().size)>> : std::true_type {};
+
+  template<typename Alloc, typename = void>
+  struct has_release : std::false_type {};
+  template<typename Alloc>
+  struct has_release<Alloc, std::void_t<decltype(std::declval<Alloc &>().release())>> : std::true_type {};
+
+} // namespace dp::tree::detail
+
+
+// --------------------------------------- slab_allocator
+namespace dp::tree::detail {
+
+  /**
+   * @brief slab_pool serves the objects of one size from big slabs.
+   * @details Each slab is twice the size of the previous one (up to 64K
+   * objects), a freed object goes to a free list and is reused first.
+   */
+  class slab_pool {
+  public:
+    using size_type = std::size_t;
+    using word = std::max_align_t;
+
+    static constexpr size_type first_slab = 64;
+    static constexpr size_type max_slab = 65536;
+
+    // \a size and \a align are those of the slots, already rounded up to hold a free list link
+    slab_pool(size_type size_, size_type align_)
+        : size(size_)
+        , align(align_) {}
+
+    void *allocate() {
+      slot *s;
+      if (free_list) {
+        s = free_list;
+        free_list = s->next;
+      } else {
+        if (cursor == end) grow();
+        s = reinterpret_cast<slot *>(cursor);
+        cursor += size;
+      }
+      in_use++;
+      return s;
+    }
+    void deallocate(void *p) noexcept {
+      auto *s = static_cast<slot *>(p);
+      s->next = free_list;
+      free_list = s;
+      in_use--;
+    }
+    void release() noexcept {
+      slabs.clear();
+      free_list = nullptr;
+      cursor = end = nullptr;
+      next_slab = first_slab;
+      capacity = in_use = 0;
+    }
+
+    size_type const size, align;
+    size_type capacity{}, in_use{};
+
+  private:
+    struct slot {
+      slot *next;
+    };
+
+    void grow() {
+      auto words = (next_slab * size + sizeof(word) - 1) / sizeof(word);
+      slabs.emplace_back(new word[words]);
+      cursor = reinterpret_cast<unsigned char *>(slabs.back().get());
+      end = cursor + next_slab * size;
+      capacity += next_slab;
+      next_slab = std::min(next_slab * 2, max_slab);
+    }
+
+    std::vector<std::unique_ptr<word[]>> slabs{};
+    slot *free_list{};
+    unsigned char *cursor{}, *end{};
+    size_type next_slab{first_slab};
+  };
+
+  /**
+   * @brief slab_arena holds a slab_pool per object size, it's shared by
+   * a slab_allocator and all the copies rebound from it.
+   */
+  class slab_arena {
+  public:
+    using size_type = std::size_t;
 
-    // rb_node_t() {}
-    ~rb_node_t() {
-      if (left) delete left;
-      if (right) delete right;
+    slab_pool *find(size_type size, size_type align) noexcept {
+      for (auto &p : _pools)
+        if (p->size == size && p->align == align) return p.get();
+      return nullptr;
     }
+    slab_pool &pool(size_type size, size_type align) {
+      if (auto *p = find(size, align)) return *p;
+      return *_pools.emplace_back(std::make_unique<slab_pool>(size, align));
+    }
+    void release() noexcept {
+      for (auto &p : _pools) p->release();
+    }
+
+  private:
+    std::vector<std::unique_ptr<slab_pool>> _pools{}; // a pool never moves, the allocators keep a pointer to theirs
   };
 
 } // namespace dp::tree::detail
 
+namespace dp::tree {
+
+  /**
+   * @brief slab_allocator places the objects contiguously in big slabs.
+   *
+   * It serves single objects (the nodes of a tree) from a bump pointer
+   * into the current slab, each slab twice the size of the previous one
+   * (up to 64K objects). Freed objects go to a free list and are reused
+   * first. release() frees all the slabs at once, without visiting the
+   * objects.
+   *
+   * The copies of an allocator share its arena, the rebound ones too:
+   * the arena keeps a pool of slabs per object size, so a container
+   * allocates its nodes from the arena of the allocator it was given,
+   * and the allocators compare equal when they share the arena. A
+   * moved-from allocator starts a new arena on its next allocation.
+   * Requests for more than one object go to std::allocator. It is not
+   * thread-safe.
+   *
+   * @code{c++}
+   * dp::tree::rb_tree&lt;int, dp::tree::detail::rb_node_t&lt;int&gt;, dp::tree::slab_allocator&lt;int&gt;&gt; t;
+   * @endcode
+   */
+  template<typename T>
+  class slab_allocator {
+  public:
+    using value_type = T;
+    using size_type = std::size_t;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap = std::true_type;
+
+    static_assert(alignof(T) <= alignof(std::max_align_t), "slab_allocator does not serve over-aligned types");
+
+    slab_allocator()
+        : _arena(std::make_shared<detail::slab_arena>()) {}
+    template<typename U>
+    slab_allocator(slab_allocator<U> const &o) noexcept
+        : _arena(o._arena) {}
+
+    T *allocate(size_type n) {
+      if (n != 1) return std::allocator<T>{}.allocate(n);
+      if (!_arena) _arena = std::make_shared<detail::slab_arena>(), _pool = nullptr; // moved from
+      return static_cast<T *>(pool().allocate());
+    }
+    void deallocate(T *p, size_type n) noexcept {
+      if (n != 1) return std::allocator<T>{}.deallocate(p, n);
+      pool().deallocate(p);
+    }
+
+    /** @brief release frees every object of the arena at once, of any type, their destructors are not called. */
+    void release() noexcept {
+      if (_arena) _arena->release();
+    }
+    /** @brief exclusive tells whether no other allocator shares the arena. */
+    bool exclusive() const noexcept { return _arena.use_count() == 1; }
+    /** @brief capacity is the count of the objects of this size the slabs can hold. */
+    size_type capacity() const noexcept {
+      auto *p = find();
+      return p ? p->capacity : 0;
+    }
+    /** @brief in_use is the count of the objects of this size allocated and not freed. */
+    size_type in_use() const noexcept {
+      auto *p = find();
+      return p ? p->in_use : 0;
+    }
+
+    template<typename U>
+    bool operator==(slab_allocator<U> const &o) const noexcept { return _arena == o._arena; }
+    template<typename U>
+    bool operator!=(slab_allocator<U> const &o) const noexcept { return !(*this == o); }
+
+  private:
+    template<typename U>
+    friend class slab_allocator;
+
+    // a slot holds a T or, once freed, the link of the free list
+    static constexpr size_type slot_align = std::max(alignof(T), alignof(void *));
+    static constexpr size_type slot_size = (std::max(sizeof(T), sizeof(void *)) + slot_align - 1) / slot_align * slot_align;
+
+    detail::slab_pool &pool() {
+      if (!_pool) _pool = &_arena->pool(slot_size, slot_align);
+      return *_pool;
+    }
+    detail::slab_pool *find() const noexcept {
+      return _arena ? _arena->find(slot_size, slot_align) : nullptr;
+    }
+
+    std::shared_ptr<detail::slab_arena> _arena;
+    detail::slab_pool *_pool{}; // the pool of T in _arena, looked up on the first use
+  };
+
+} // namespace dp::tree
+
 
 // --------------------------------------- rb_tree
+namespace dp::tree::detail {
+
+  template<typename Compare, typename = void>
+  struct is_transparent : std::false_type {};
+  template<typename Compare>
+  struct is_transparent<Compare, std::void_t<typename Compare::is_transparent>> : std::true_type {};
+
+  /**
+   * @brief a bidirectional iterator over the keys of a rb_tree, in order.
+   * @details It walks by the parent pointers. The keys are constant, a
+   * change would break the order. Decrementing end() gives the last key,
+   * so the iterator keeps the tree as well as the node.
+   */
+  template<typename Tree>
+  class rb_iterator {
+  public:
+    using difference_type = std::ptrdiff_t;
+    using value_type = typename Tree::value_type;
+    using pointer = value_type const *;
+    using reference = value_type const &;
+    using iterator_category = std::bidirectional_iterator_tag;
+    using NodePtr = typename Tree::NodePtr;
+    using self = rb_iterator;
+
+    rb_iterator() {}
+    rb_iterator(NodePtr node_, Tree const *tree_)
+        : _node(node_)
+        , _tree(tree_) {}
+
+    bool operator==(self const &r) const { return _node == r._node; }
+    bool operator!=(self const &r) const { return _node != r._node; }
+    reference operator*() const { return _node->key; }
+    pointer operator->() const { return &_node->key; }
+    /** @brief node returns the node under the iterator, nullptr for end(). */
+    NodePtr node() const { return _node; }
+
+    self &operator++() {
+      auto *p = _node;
+      if (p->right) {
+        for (p = p->right; p->left;) p = p->left;
+      } else {
+        while (p->parent && p->parent->right == p) p = p->parent;
+        p = p->parent;
+      }
+      _node = p;
+      return *this;
+    }
+    self operator++(int) {
+      self copy{*this};
+      ++(*this);
+      return copy;
+    }
+    self &operator--() {
+      auto *p = _node;
+      if (!p) {
+        for (p = _tree->root(); p->right;) p = p->right;
+      } else if (p->left) {
+        for (p = p->left; p->right;) p = p->right;
+      } else {
+        while (p->parent && p->parent->left == p) p = p->parent;
+        p = p->parent;
+      }
+      _node = p;
+      return *this;
+    }
+    self operator--(int) {
+      self copy{*this};
+      --(*this);
+      return copy;
+    }
+
+  private:
+    NodePtr _node{};
+    Tree const *_tree{};
+  };
+
+} // namespace dp::tree::detail
+
 namespace dp::tree {
 
-  template<typename Data, typename Node = detail::rb_node_t<Data>>
+  /**
+   * @brief rb_tree is a red-black tree.
+   * @details The nodes are allocated by a rebound copy of \a Alloc. With
+   * slab_allocator the nodes sit contiguously in slabs and clear() frees
+   * them all at once.
+   *
+   * The count of the elements is kept up to date, count() is O(1). With
+   * detail::rb_os_node_t as \a Node (see os_rb_tree), every node keeps
+   * the size of its subtree and rank() and select() run in O(log n).
+   *
+   * It is an ordered set of unique keys, as std::set: the keys are
+   * ordered by \a Compare, begin()/end() iterate them in order and
+   * find(), lower_bound(), upper_bound() look them up. With a transparent
+   * comparator (std::less&lt;&gt;) the lookups take any type comparable with
+   * the keys. emplace() builds the key right inside its node.
+   *
+   * @code{c++}
+   * dp::tree::rb_tree&lt;std::string, dp::tree::detail::rb_node_t&lt;std::string&gt;, std::allocator&lt;std::string&gt;, std::less&lt;&gt;&gt; t;
+   * t.emplace(3, 'x');
+   * if (auto it = t.find(std::string_view{"xxx"}); it != t.end())
+   *   t.erase(it);
+   * @endcode
+   */
+  template<typename Data, typename Node = detail::rb_node_t<Data>, typename Alloc = std::allocator<Data>, typename Compare = std::less<Data>>
   class rb_tree : public detail::tree_ops<Node> {
   public:
-    rb_tree() {}
-    ~rb_tree() { clear(); }
-
     using Base = detail::tree_ops<Node>;
     using size_type = typename Base::size_type;
     using TreePtr = typename Base::NodePtr;
     using NodePtr = typename Base::NodePtr;
+    using allocator_type = Alloc;
+    using node_allocator = typename std::allocator_traits<Alloc>::template rebind_alloc<Node>;
+    using node_alloc_traits = std::allocator_traits<node_allocator>;
+    using key_type = Data;
+    using value_type = Data;
+    using key_compare = Compare;
+    using iterator = detail::rb_iterator<rb_tree>;
+    using const_iterator = iterator;
+    using reverse_iterator = std::reverse_iterator<iterator>;
+    using const_reverse_iterator = reverse_iterator;
+
+    rb_tree() {}
+    explicit rb_tree(Alloc const &alloc)
+        : _alloc(alloc) {}
+    explicit rb_tree(Compare const &comp, Alloc const &alloc = Alloc())
+        : _alloc(alloc)
+        , _comp(comp) {}
+    rb_tree(rb_tree const &) = delete;
+    rb_tree &operator=(rb_tree const &) = delete;
+    rb_tree(rb_tree &&o) noexcept
+        : _root(o._root)
+        , _size(o._size)
+        , _alloc(std::move(o._alloc))
+        , _comp(std::move(o._comp)) { o._root = nullptr, o._size = 0; }
+    rb_tree &operator=(rb_tree &&o) noexcept {
+      if (this != &o) {
+        clear();
+        _root = o._root, o._root = nullptr;
+        _size = o._size, o._size = 0;
+        _alloc = std::move(o._alloc);
+        _comp = std::move(o._comp);
+      }
+      return *this;
+    }
+    ~rb_tree() { clear(); }
+
+    static constexpr bool order_statistics = detail::has_subtree_size<Node>::value;
 
   private:
     NodePtr _root{nullptr};
+    size_type _size{};
+    node_allocator _alloc{};
+    Compare _comp{};
+
+    // enables a lookup by K: a key, or anything when the comparator is transparent
+    template<typename K>
+    using lookup_t = std::enable_if_t<std::is_same_v<K, Data> || detail::is_transparent<Compare>::value>;
 
   public:
     void clear() {
-      if (_root) {
-        delete _root;
-        _root = nullptr;
+      if constexpr (detail::has_release<node_allocator>::value) {
+        if (_alloc.exclusive()) {
+          if constexpr (!std::is_trivially_destructible_v<Node>)
+            destroy_subtree(_root, false);
+          _root = nullptr;
+          _size = 0;
+          _alloc.release();
+          return;
+        }
       }
+      destroy_subtree(_root, true);
+      _root = nullptr;
+      _size = 0;
     }
 
+    allocator_type get_allocator() const { return allocator_type(_alloc); }
+    /** @brief get_node_allocator returns the allocator of the nodes, for slab_allocator it shares the arena of the one given to the tree. */
+    node_allocator const &get_node_allocator() const { return _alloc; }
+    key_compare key_comp() const { return _comp; }
+
     NodePtr root() { return _root; }
     const NodePtr root() const { return _root; }
+    /** @brief height walks the whole tree, see height_bound() for an O(log n) estimation. */
     size_type height() const { return Base::calc_height(_root); }
-    size_type count() const { return Base::calc_count(_root); }
+    size_type count() const { return _size; }
+    size_type size() const { return _size; }
+    bool empty() const { return _size == 0; }
+
+    /** @brief black_height is the count of the black nodes on a path from the root down to a leaf. */
+    size_type black_height() const {
+      size_type h{};
+      for (auto *p = _root; p; p = p->left)
+        if (!p->color_is_red) h++;
+      return h;
+    }
+    /** @brief height_bound is an upper bound of height(): a path holds no more red nodes than black ones. */
+    size_type height_bound() const { return 2 * black_height(); }
+
+    /**
+     * @brief rank returns the count of the keys less than \a key.
+     * @details It needs the order statistics (os_rb_tree).
+     */
+    template<typename K>
+    size_type rank(K const &key) const {
+      static_assert(order_statistics, "rank() needs a node keeping the subtree size, such as detail::rb_os_node_t");
+      size_type r{};
+      for (auto *p = _root; p;) {
+        if (_comp(p->key, key)) {
+          r += subtree_size(p->left) + 1;
+          p = p->right;
+        } else {
+          p = p->left;
+        }
+      }
+      return r;
+    }
+    /**
+     * @brief select returns the node of the \a i-th smallest key (from 0), or nullptr.
+     * @details It needs the order statistics (os_rb_tree).
+     */
+    NodePtr select(size_type i) const {
+      static_assert(order_statistics, "select() needs a node keeping the subtree size, such as detail::rb_os_node_t");
+      for (auto *p = _root; p;) {
+        auto left = subtree_size(p->left);
+        if (i < left) {
+          p = p->left;
+        } else if (i == left) {
+          return p;
+        } else {
+          i -= left + 1;
+          p = p->right;
+        }
+      }
+      return nullptr;
+    }
 
-    void insert(Data const &v) {
-      if (_root == nullptr) {
-        _root = new Node{v};
-        return;
+  public:
+    iterator begin() const {
+      auto *p = _root;
+      if (p)
+        while (p->left) p = p->left;
+      return iterator{p, this};
+    }
+    iterator end() const { return iterator{nullptr, this}; }
+    iterator cbegin() const { return begin(); }
+    iterator cend() const { return end(); }
+    reverse_iterator rbegin() const { return reverse_iterator{end()}; }
+    reverse_iterator rend() const { return reverse_iterator{begin()}; }
+    reverse_iterator crbegin() const { return rbegin(); }
+    reverse_iterator crend() const { return rend(); }
+
+    template<typename K, typename = lookup_t<K>>
+    iterator find(K const &key) const {
+      auto it = lower_bound(key);
+      return (it.node() && !_comp(key, it.node()->key)) ? it : end();
+    }
+    iterator find(Data const &key) const { return find<Data>(key); }
+    template<typename K, typename = lookup_t<K>>
+    bool contains(K const &key) const { return find(key) != end(); }
+    bool contains(Data const &key) const { return find(key) != end(); }
+    /** @brief count returns 1 if \a key is in the tree, or 0. */
+    template<typename K, typename = lookup_t<K>>
+    size_type count(K const &key) const { return contains(key) ? 1 : 0; }
+    size_type count(Data const &key) const { return contains(key) ? 1 : 0; }
+
+    /** @brief lower_bound returns the first key not less than \a key. */
+    template<typename K, typename = lookup_t<K>>
+    iterator lower_bound(K const &key) const {
+      NodePtr r{};
+      for (auto *p = _root; p;) {
+        if (_comp(p->key, key)) {
+          p = p->right;
+        } else {
+          r = p;
+          p = p->left;
+        }
       }
-      auto *node = new Node{v};
-      insert_rbt(_root, node);
+      return iterator{r, this};
     }
-    void insert(Data &&v) {
-      if (_root == nullptr) {
-        _root = new Node{std::move(v)};
-        return;
+    iterator lower_bound(Data const &key) const { return lower_bound<Data>(key); }
+    /** @brief upper_bound returns the first key greater than \a key. */
+    template<typename K, typename = lookup_t<K>>
+    iterator upper_bound(K const &key) const {
+      NodePtr r{};
+      for (auto *p = _root; p;) {
+        if (_comp(key, p->key)) {
+          r = p;
+          p = p->left;
+        } else {
+          p = p->right;
+        }
       }
-      auto *node = new Node{std::move(v)};
-      insert_rbt(_root, node);
+      return iterator{r, this};
+    }
+    iterator upper_bound(Data const &key) const { return upper_bound<Data>(key); }
+    template<typename K, typename = lookup_t<K>>
+    std::pair<iterator, iterator> equal_range(K const &key) const {
+      auto it = lower_bound(key);
+      if (it.node() && !_comp(key, it.node()->key))
+        return {it, std::next(it)};
+      return {it, it};
+    }
+    std::pair<iterator, iterator> equal_range(Data const &key) const { return equal_range<Data>(key); }
+
+  public:
+    /** @brief insert adds \a v unless its key exists, and returns where the key is, and whether it was added. */
+    std::pair<iterator, bool> insert(Data const &v) {
+      return insert_unique(v, v);
+    }
+    std::pair<iterator, bool> insert(Data &&v) {
+      return insert_unique(v, std::move(v));
+    }
+    template<typename InputIt>
+    void insert(InputIt first, InputIt last) {
+      for (; first != last; ++first) insert(*first);
     }
+    /**
+     * @brief emplace builds the key from \a args in its node, then links
+     * it; the node is freed if the key exists already.
+     */
     template<typename... Args>
-    void emplace(Args &&...args) {
-      if (_root == nullptr) {
-        _root = new Node{std::move(Data{args...})};
-        return;
+    std::pair<iterator, bool> emplace(Args &&...args) {
+      auto *node = create_node(std::forward<Args>(args)...);
+      NodePtr parent;
+      bool left;
+      if (auto *found = insert_pos(node->key, parent, left); found) {
+        destroy_node(node);
+        return {iterator{found, this}, false};
       }
-      auto *node = new Node{std::move(Data{args...})};
-      insert_rbt(_root, node);
+      link(parent, left, node);
+      return {iterator{node, this}, true};
     }
 
-  private:
-    int insert_rbt(NodePtr &root, NodePtr node);
-    int insert_rbt_fixup(NodePtr &root, NodePtr node);
-    static NodePtr rbt_rotate_right(NodePtr &root, NodePtr node);
-    static NodePtr rbt_rotate_left(NodePtr &root, NodePtr node);
+    /** @brief erase removes \a key, and returns the count of the keys removed, 0 or 1. */
+    template<typename K, typename = lookup_t<K>>
+    size_type erase(K const &key) {
+      auto it = find(key);
+      if (it == end())
+        return 0;
+      erase(it);
+      return 1;
+    }
+    size_type erase(Data const &key) { return erase<Data>(key); }
+    /** @brief erase removes the key under \a pos, and returns the iterator to the next one. */
+    iterator erase(iterator pos) {
+      auto next = std::next(pos);
+      delete_rbt(_root, pos.node());
+      _size--;
+      return next;
+    }
+    /** @brief erase removes the keys in [first, last). */
+    iterator erase(iterator first, iterator last) {
+      if (first == begin() && last == end()) {
+        clear();
+        return end();
+      }
+      while (first != last)
+        first = erase(first);
+      return last;
+    }
 
   public:
-    bool erase(int v) {
-      if (_root)
-        return delete_rbt(_root, v) == 0;
-      return false;
+    /**
+     * @brief from_sorted builds a tree from the keys in [first, last),
+     * which must be sorted by \a comp, in O(n) without any rotation.
+     * @details The nodes are allocated in one pass (the duplicates are
+     * dropped) and linked into a perfectly balanced tree: all the levels
+     * are black but the deepest one, red when it is incomplete.
+     */
+    template<typename InputIt>
+    static rb_tree from_sorted(InputIt first, InputIt last, Compare const &comp = Compare(), Alloc const &alloc = Alloc()) {
+      rb_tree t{comp, alloc};
+      std::vector<NodePtr> nodes;
+      if constexpr (std::is_base_of_v<std::forward_iterator_tag, typename std::iterator_traits<InputIt>::iterator_category>)
+        nodes.reserve((std::size_t) std::distance(first, last));
+      for (; first != last; ++first) {
+        auto *node = t.create_node(*first);
+        if (!nodes.empty() && !t._comp(nodes.back()->key, node->key)) {
+          assert(!t._comp(node->key, nodes.back()->key) && "from_sorted() needs a sorted input");
+          t.destroy_node(node);
+          continue;
+        }
+        nodes.push_back(node);
+      }
+      t.rebuild(nodes);
+      return t;
+    }
+
+    /**
+     * @brief merge moves the keys of \a o into this tree in O(n + m): the
+     * two in-order sequences are merged and the tree is rebuilt balanced.
+     * @details The nodes of \a o are relinked when the allocators are
+     * equal, otherwise their keys are moved into new nodes. On a key in
+     * both trees, the one of this tree is kept. \a o is left empty.
+     */
+    void merge(rb_tree &&o) {
+      if (&o == this || o.empty())
+        return;
+      std::vector<NodePtr> a, b, nodes;
+      a.reserve(_size), b.reserve(o._size), nodes.reserve(_size + o._size);
+      for (auto it = begin(); it != end(); ++it) a.push_back(it.node());
+      for (auto it = o.begin(); it != o.end(); ++it) b.push_back(it.node());
+      o._root = nullptr, o._size = 0;
+
+      bool relink = _alloc == o._alloc;
+      auto take = [this, &o, relink](NodePtr p) {
+        if (relink) return p;
+        auto *node = create_node(std::move(p->key));
+        o.destroy_node(p);
+        return node;
+      };
+      auto ia = a.begin(), ib = b.begin();
+      while (ia != a.end() && ib != b.end()) {
+        if (_comp((*ia)->key, (*ib)->key)) {
+          nodes.push_back(*ia++);
+        } else if (_comp((*ib)->key, (*ia)->key)) {
+          nodes.push_back(take(*ib++));
+        } else {
+          nodes.push_back(*ia++);
+          o.destroy_node(*ib++);
+        }
+      }
+      nodes.insert(nodes.end(), ia, a.end());
+      for (; ib != b.end(); ++ib) nodes.push_back(take(*ib));
+      rebuild(nodes);
+    }
+
+  private:
+    // links the sorted nodes into a balanced tree, replacing the current
+    // links; the nodes at the deepest level are red unless it is full.
+    void rebuild(std::vector<NodePtr> &nodes) {
+      size_type n = nodes.size(), levels{};
+      while ((size_type(1) << levels) <= n) levels++;
+      auto red_level = (n + 1 == (size_type(1) << levels)) ? levels : levels - 1;
+      _root = build_balanced(nodes.data(), n, nullptr, 0, red_level);
+      _size = n;
+    }
+    static NodePtr build_balanced(NodePtr *nodes, size_type n, NodePtr parent, size_type level, size_type red_level) {
+      if (n == 0)
+        return nullptr;
+      auto mid = n / 2;
+      auto *p = nodes[mid];
+      p->parent = parent;
+      p->color_is_red = level == red_level;
+      p->left = build_balanced(nodes, mid, p, level + 1, red_level);
+      p->right = build_balanced(nodes + mid + 1, n - mid - 1, p, level + 1, red_level);
+      if constexpr (order_statistics)
+        p->size = n;
+      return p;
     }
 
   private:
-    int delete_rbt(NodePtr &root, int key);
-    static int delete_rbt_fixup(NodePtr &root, NodePtr node, NodePtr parent);
+    // builds the key in place: parentheses when a constructor takes the
+    // args, braces for an aggregate. The key is returned as a prvalue, so
+    // it is never copied nor moved on the way into the node.
+    template<typename... Args>
+    static Data make_key(Args &&...args) {
+      if constexpr (std::is_constructible_v<Data, Args &&...>)
+        return Data(std::forward<Args>(args)...);
+      else
+        return Data{std::forward<Args>(args)...};
+    }
+    template<typename... Args>
+    NodePtr create_node(Args &&...args) {
+      NodePtr p = node_alloc_traits::allocate(_alloc, 1);
+      try {
+        ::new ((void *) p) Node{make_key(std::forward<Args>(args)...)};
+      } catch (...) {
+        node_alloc_traits::deallocate(_alloc, p, 1);
+        throw;
+      }
+      return p;
+    }
+    void destroy_node(NodePtr p) {
+      p->~Node();
+      node_alloc_traits::deallocate(_alloc, p, 1);
+    }
+    // post-order, iteratively: climbs back by the parent pointers
+    void destroy_subtree(NodePtr node, bool deallocate) {
+      while (node) {
+        if (node->left) {
+          node = node->left;
+        } else if (node->right) {
+          node = node->right;
+        } else {
+          auto *parent = node->parent;
+          if (parent)
+            (parent->left == node ? parent->left : parent->right) = nullptr;
+          if (deallocate)
+            destroy_node(node);
+          else
+            node->~Node();
+          node = parent;
+        }
+      }
+    }
+
+    // insert_pos returns the node holding \a key, or nullptr and the
+    // place where it goes: under \a parent, on its left or right
+    template<typename K>
+    NodePtr insert_pos(K const &key, NodePtr &parent, bool &left) const {
+      NodePtr p = _root;
+      parent = nullptr, left = false;
+      while (p) {
+        parent = p;
+        if (_comp(key, p->key)) {
+          p = p->left, left = true;
+        } else if (_comp(p->key, key)) {
+          p = p->right, left = false;
+        } else {
+          return p;
+        }
+      }
+      return nullptr;
+    }
+    // the key is looked up before a node is allocated for it
+    template<typename V>
+    std::pair<iterator, bool> insert_unique(Data const &key, V &&v) {
+      NodePtr parent;
+      bool left;
+      if (auto *found = insert_pos(key, parent, left); found)
+        return {iterator{found, this}, false};
+      auto *node = create_node(std::forward<V>(v));
+      link(parent, left, node);
+      return {iterator{node, this}, true};
+    }
+    void link(NodePtr parent, bool left, NodePtr node) {
+      insert_rbt(_root, parent, left, node);
+      _size++;
+    }
+
+    static size_type subtree_size(NodePtr node) {
+      if constexpr (order_statistics)
+        return node ? node->size : 0;
+      else
+        return 0;
+    }
+    static void update_size(NodePtr node) {
+      if constexpr (order_statistics)
+        node->size = 1 + subtree_size(node->left) + subtree_size(node->right);
+    }
+    // recomputes the subtree sizes from node up to the root
+    static void update_sizes_upward(NodePtr node) {
+      if constexpr (order_statistics)
+        for (; node; node = node->parent)
+          update_size(node);
+    }
+
+    static void insert_rbt(NodePtr &root, NodePtr parent, bool left, NodePtr node);
+    static void insert_rbt_fixup(NodePtr &root, NodePtr node);
+    static NodePtr rbt_rotate_right(NodePtr &root, NodePtr node);
+    static NodePtr rbt_rotate_left(NodePtr &root, NodePtr node);
+    void delete_rbt(NodePtr &root, NodePtr p);
+    static void delete_rbt_fixup(NodePtr &root, NodePtr node, NodePtr parent);
   };
 
+  /**
+   * @brief os_rb_tree is a rb_tree with the order statistics, rank() and select().
+   */
+  template<typename Data, typename Alloc = std::allocator<Data>, typename Compare = std::less<Data>>
+  using os_rb_tree = rb_tree<Data, detail::rb_os_node_t<Data>, Alloc, Compare>;
+
 } // namespace dp::tree
 
 // --------------------------------------- rb_tree inline objs
 namespace dp::tree {
 
-  template<typename Data, typename Node>
-  inline int rb_tree<Data, Node>::insert_rbt(NodePtr &root, NodePtr node) {
-    NodePtr p = root, last = nullptr;
-
-    //find the position we need to insert
-    while (p) {
-      last = p;
-      if (p->key == node->key)
-        return 1;
-      p = (p->key < node->key) ? p->right : p->left;
-    }
-
-    node->parent = last;
+  template<typename Data, typename Node, typename Alloc, typename Compare>
+  inline void rb_tree<Data, Node, Alloc, Compare>::insert_rbt(NodePtr &root, NodePtr parent, bool left, NodePtr node) {
+    node->parent = parent;
     node->color_is_red = true;
-    if (last != nullptr) {
-      if (node->key < last->key)
-        last->left = node;
+    if (parent != nullptr) {
+      if (left)
+        parent->left = node;
       else
-        last->right = node;
+        parent->right = node;
     } else {
       root = node;
     }
+    if constexpr (order_statistics)
+      for (auto *q = parent; q; q = q->parent)
+        q->size++;
 
-    return insert_rbt_fixup(root, node);
+    insert_rbt_fixup(root, node);
   }
 
-  template<typename Data, typename Node>
-  inline int rb_tree<Data, Node>::insert_rbt_fixup(NodePtr &root, NodePtr node) {
+  template<typename Data, typename Node, typename Alloc, typename Compare>
+  inline void rb_tree<Data, Node, Alloc, Compare>::insert_rbt_fixup(NodePtr &root, NodePtr node) {
     NodePtr parent;
     NodePtr grandpa;
 
@@ -305,14 +1221,13 @@ namespace dp::tree {
     }
 
     root->color_is_red = false;
-    return 0;
   }
 
   //          d                   b
   //       b      f     ->     a     d
   //     a   c                     c   f
-  template<typename Data, typename Node>
-  inline typename rb_tree<Data, Node>::NodePtr rb_tree<Data, Node>::rbt_rotate_right(NodePtr &root, NodePtr node) {
+  template<typename Data, typename Node, typename Alloc, typename Compare>
+  inline typename rb_tree<Data, Node, Alloc, Compare>::NodePtr rb_tree<Data, Node, Alloc, Compare>::rbt_rotate_right(NodePtr &root, NodePtr node) {
     NodePtr left = node->left;
     left->parent = node->parent;
     if (node->parent) {
@@ -326,7 +1241,13 @@ namespace dp::tree {
 
     node->parent = left;
     node->left = left->right;
+    if (node->left)
+      node->left->parent = node;
     left->right = node;
+    if constexpr (order_statistics) {
+      left->size = node->size;
+      update_size(node);
+    }
     return left;
   }
 
@@ -334,8 +1255,8 @@ namespace dp::tree {
   //       b      f     ->     d     g
   //             e  g        b   e
   //
-  template<typename Data, typename Node>
-  inline typename rb_tree<Data, Node>::NodePtr rb_tree<Data, Node>::rbt_rotate_left(NodePtr &root, NodePtr node) {
+  template<typename Data, typename Node, typename Alloc, typename Compare>
+  inline typename rb_tree<Data, Node, Alloc, Compare>::NodePtr rb_tree<Data, Node, Alloc, Compare>::rbt_rotate_left(NodePtr &root, NodePtr node) {
     NodePtr right = node->right;
 
     right->parent = node->parent;
@@ -350,22 +1271,18 @@ namespace dp::tree {
 
     node->parent = right;
     node->right = right->left;
+    if (node->right)
+      node->right->parent = node;
     right->left = node;
+    if constexpr (order_statistics) {
+      right->size = node->size;
+      update_size(node);
+    }
     return right;
   }
 
-  template<typename Data, typename Node>
-  inline int rb_tree<Data, Node>::delete_rbt(NodePtr &root, int key) {
-    NodePtr p = root;
-    while (p) {
-      if (p->key == key)
-        break;
-      p = (p->key < key) ? p->right : p->left;
-    }
-
-    if (!p)
-      return -1;
-
+  template<typename Data, typename Node, typename Alloc, typename Compare>
+  inline void rb_tree<Data, Node, Alloc, Compare>::delete_rbt(NodePtr &root, NodePtr p) {
     if (p->left && p->right) {
       NodePtr successor = p->right;
 
@@ -401,14 +1318,15 @@ namespace dp::tree {
       successor->color_is_red = p->color_is_red;
       successor->left = p->left;
       p->left->parent = successor;
+      update_sizes_upward(successor_parent);
 
       if (!color_is_red)
         delete_rbt_fixup(root, successor_child, successor_parent);
 
       p->left = nullptr;
       p->right = nullptr;
-      delete (p);
-      return 0;
+      destroy_node(p);
+      return;
     }
 
     auto child = (p->left) ? p->left : p->right;
@@ -426,17 +1344,17 @@ namespace dp::tree {
     } else {
       root = child;
     }
+    update_sizes_upward(parent);
 
     if (!color_is_red)
       delete_rbt_fixup(root, child, parent);
 
     p->left = p->right = nullptr;
-    delete (p);
-    return 0;
+    destroy_node(p);
   }
 
-  template<typename Data, typename Node>
-  inline int rb_tree<Data, Node>::delete_rbt_fixup(NodePtr &root, NodePtr node, NodePtr parent) {
+  template<typename Data, typename Node, typename Alloc, typename Compare>
+  inline void rb_tree<Data, Node, Alloc, Compare>::delete_rbt_fixup(NodePtr &root, NodePtr node, NodePtr parent) {
     NodePtr brother = nullptr;
 
     while ((!node || !node->color_is_red) && node != root) {
@@ -451,7 +1369,7 @@ namespace dp::tree {
           // Case 1: x's brother is COLOR_RED
           brother->color_is_red = false;
           parent->color_is_red = true;
-          rbt_rotate_left(root, node);
+          rbt_rotate_left(root, parent);
           brother = parent->right;
         }
 
@@ -522,19 +1440,1127 @@ namespace dp::tree {
     if (node) {
       node->color_is_red = false;
     }
-    return 0;
   }
 
 } // namespace dp::tree
 
 
 // --------------------------------------- btree
-namespace dp::tree {
+namespace dp::tree::detail {
 
-  class btree__t__ {
+  /**
+   * @brief a bidirectional iterator over the keys of a btree, in order.
+   * @details It holds a leaf and an index in it, and steps to the
+   * neighbour leaves by their links. Any insert or erase invalidates it.
+   */
+  template<typename Tree>
+  class btree_iterator {
   public:
+    using difference_type = std::ptrdiff_t;
+    using value_type = typename Tree::value_type;
+    using pointer = value_type const *;
+    using reference = value_type const &;
+    using iterator_category = std::bidirectional_iterator_tag;
+    using leaf_node = typename Tree::leaf_node;
+    using self = btree_iterator;
+
+    btree_iterator() {}
+    btree_iterator(leaf_node *leaf_, std::size_t index_, Tree const *tree_)
+        : _leaf(leaf_)
+        , _index(index_)
+        , _tree(tree_) {}
+
+    bool operator==(self const &r) const { return _leaf == r._leaf && _index == r._index; }
+    bool operator!=(self const &r) const { return !(*this == r); }
+    reference operator*() const { return _leaf->keys[_index]; }
+    pointer operator->() const { return &_leaf->keys[_index]; }
+    leaf_node *leaf() const { return _leaf; }
+    std::size_t index() const { return _index; }
+
+    self &operator++() {
+      if (++_index == _leaf->count) {
+        _leaf = _leaf->next;
+        _index = 0;
+      }
+      return *this;
+    }
+    self operator++(int) {
+      self copy{*this};
+      ++(*this);
+      return copy;
+    }
+    self &operator--() {
+      if (!_leaf) {
+        _leaf = _tree->last_leaf();
+        _index = _leaf->count - 1;
+      } else if (_index == 0) {
+        _leaf = _leaf->prev;
+        _index = _leaf->count - 1;
+      } else {
+        _index--;
+      }
+      return *this;
+    }
+    self operator--(int) {
+      self copy{*this};
+      --(*this);
+      return copy;
+    }
+
+  private:
+    leaf_node *_leaf{};
+    std::size_t _index{};
+    Tree const *_tree{};
   };
 
+} // namespace dp::tree::detail
+
+namespace dp::tree {
+
+  /**
+   * @brief btree is an in-memory B+-tree, an ordered set of unique keys
+   * with the same surface as rb_tree.
+   *
+   * The nodes are about \a NodeBytes wide (a few cache lines by default)
+   * and hold their keys in a sorted array, so a lookup touches a handful
+   * of nodes instead of one per level of a binary tree. The keys are in
+   * the leaves only, the leaves are linked both ways and a range scan is
+   * a walk over contiguous arrays.
+   *
+   * Inside a node, arithmetic keys under std::less are searched by
+   * counting the smaller keys without branches (with SSE2 for 32-bit
+   * integers), other keys by a binary search.
+   *
+   * Unlike rb_tree, insert() and erase() move the keys between the
+   * nodes: they invalidate all the iterators. Data must be default
+   * constructible and copyable, the separators in the inner nodes are
+   * copies of keys.
+   *
+   * @code{c++}
+   * dp::tree::btree&lt;int&gt; t;
+   * for (int i = 0; i &lt; 1000; i++) t.insert(i);
+   * for (auto it = t.lower_bound(100); it != t.end() &amp;&amp; *it &lt; 200; ++it) use(*it);
+   * @endcode
+   */
+  template<typename Data, typename Compare = std::less<Data>, typename Alloc = std::allocator<Data>, std::size_t NodeBytes = 256>
+  class btree {
+  public:
+    using size_type = std::size_t;
+    using key_type = Data;
+    using value_type = Data;
+    using key_compare = Compare;
+    using allocator_type = Alloc;
+    using iterator = detail::btree_iterator<btree>;
+    using const_iterator = iterator;
+    using reverse_iterator = std::reverse_iterator<iterator>;
+    using const_reverse_iterator = reverse_iterator;
+
+    struct node_base {
+      bool is_leaf{};
+      std::uint32_t count{};
+    };
+
+    static constexpr size_type leaf_capacity = std::max<size_type>(4, (NodeBytes - sizeof(node_base) - 2 * sizeof(void *)) / sizeof(Data));
+    static constexpr size_type inner_capacity = std::max<size_type>(4, (NodeBytes - sizeof(node_base) - sizeof(void *)) / (sizeof(Data) + sizeof(void *)));
+
+    struct leaf_node : node_base {
+      Data keys[leaf_capacity]{};
+      leaf_node *prev{}, *next{};
+    };
+    struct inner_node : node_base {
+      Data keys[inner_capacity]{};               // keys[i] parts children[i] (less) from children[i + 1]
+      node_base *children[inner_capacity + 1]{}; // count + 1 of them
+    };
+
+    using leaf_allocator = typename std::allocator_traits<Alloc>::template rebind_alloc<leaf_node>;
+    using inner_allocator = typename std::allocator_traits<Alloc>::template rebind_alloc<inner_node>;
+
+    btree() {}
+    explicit btree(Compare const &comp, Alloc const &alloc = Alloc())
+        : _leaf_alloc(alloc)
+        , _inner_alloc(alloc)
+        , _comp(comp) {}
+    btree(btree const &) = delete;
+    btree &operator=(btree const &) = delete;
+    btree(btree &&o) noexcept { steal(o); }
+    btree &operator=(btree &&o) noexcept {
+      if (this != &o) {
+        clear();
+        steal(o);
+      }
+      return *this;
+    }
+    ~btree() { clear(); }
+
+  private:
+    static constexpr size_type min_leaf = leaf_capacity / 2;
+    static constexpr size_type min_inner = inner_capacity / 2;
+    static constexpr size_type max_height = 32;
+
+    node_base *_root{};
+    leaf_node *_first{}, *_last{};
+    size_type _size{};
+    size_type _height{};
+    leaf_allocator _leaf_alloc{};
+    inner_allocator _inner_alloc{};
+    Compare _comp{};
+
+    template<typename K>
+    using lookup_t = std::enable_if_t<std::is_same_v<K, Data> || detail::is_transparent<Compare>::value>;
+
+    // the inner nodes from the root down to a leaf, and the child taken in each
+    struct path_t {
+      inner_node *node[max_height];
+      size_type index[max_height];
+      size_type depth{};
+    };
+
+  public:
+    void clear() {
+      if (_root)
+        destroy_subtree(_root);
+      _root = nullptr;
+      _first = _last = nullptr;
+      _size = _height = 0;
+    }
+
+    allocator_type get_allocator() const { return allocator_type(_leaf_alloc); }
+    key_compare key_comp() const { return _comp; }
+
+    size_type count() const { return _size; }
+    size_type size() const { return _size; }
+    bool empty() const { return _size == 0; }
+    /** @brief height is the count of the levels, the leaves included. */
+    size_type height() const { return _height; }
+    node_base *root() const { return _root; }
+    leaf_node *last_leaf() const { return _last; }
+
+    iterator begin() const { return iterator{_first, 0, this}; }
+    iterator end() const { return iterator{nullptr, 0, this}; }
+    iterator cbegin() const { return begin(); }
+    iterator cend() const { return end(); }
+    reverse_iterator rbegin() const { return reverse_iterator{end()}; }
+    reverse_iterator rend() const { return reverse_iterator{begin()}; }
+    reverse_iterator crbegin() const { return rbegin(); }
+    reverse_iterator crend() const { return rend(); }
+
+    template<typename K, typename = lookup_t<K>>
+    iterator find(K const &key) const {
+      auto it = lower_bound(key);
+      return (it.leaf() && !_comp(key, *it)) ? it : end();
+    }
+    iterator find(Data const &key) const { return find<Data>(key); }
+    template<typename K, typename = lookup_t<K>>
+    bool contains(K const &key) const { return find(key) != end(); }
+    bool contains(Data const &key) const { return find(key) != end(); }
+    /** @brief count returns 1 if \a key is in the tree, or 0. */
+    template<typename K, typename = lookup_t<K>>
+    size_type count(K const &key) const { return contains(key) ? 1 : 0; }
+    size_type count(Data const &key) const { return contains(key) ? 1 : 0; }
+
+    /** @brief lower_bound returns the first key not less than \a key. */
+    template<typename K, typename = lookup_t<K>>
+    iterator lower_bound(K const &key) const {
+      if (!_root)
+        return end();
+      auto *leaf = descend(key, nullptr);
+      return at(leaf, search<false>(leaf->keys, leaf->count, key));
+    }
+    iterator lower_bound(Data const &key) const { return lower_bound<Data>(key); }
+    /** @brief upper_bound returns the first key greater than \a key. */
+    template<typename K, typename = lookup_t<K>>
+    iterator upper_bound(K const &key) const {
+      if (!_root)
+        return end();
+      auto *leaf = descend(key, nullptr);
+      return at(leaf, search<true>(leaf->keys, leaf->count, key));
+    }
+    iterator upper_bound(Data const &key) const { return upper_bound<Data>(key); }
+    template<typename K, typename = lookup_t<K>>
+    std::pair<iterator, iterator> equal_range(K const &key) const {
+      auto it = lower_bound(key);
+      if (it.leaf() && !_comp(key, *it))
+        return {it, std::next(it)};
+      return {it, it};
+    }
+    std::pair<iterator, iterator> equal_range(Data const &key) const { return equal_range<Data>(key); }
+
+  public:
+    /** @brief insert adds \a v unless its key exists, and returns where the key is, and whether it was added. */
+    std::pair<iterator, bool> insert(Data const &v) { return insert_unique(v, v); }
+    std::pair<iterator, bool> insert(Data &&v) { return insert_unique(v, std::move(v)); }
+    template<typename InputIt>
+    void insert(InputIt first, InputIt last) {
+      for (; first != last; ++first) insert(*first);
+    }
+    /** @brief emplace builds the key from \a args, then inserts it by move. */
+    template<typename... Args>
+    std::pair<iterator, bool> emplace(Args &&...args) {
+      if constexpr (std::is_constructible_v<Data, Args &&...>) {
+        Data key(std::forward<Args>(args)...);
+        return insert_unique(key, std::move(key));
+      } else {
+        Data key{std::forward<Args>(args)...};
+        return insert_unique(key, std::move(key));
+      }
+    }
+
+    /** @brief erase removes \a key, and returns the count of the keys removed, 0 or 1. */
+    template<typename K, typename = lookup_t<K>>
+    size_type erase(K const &key) {
+      if (!_root)
+        return 0;
+      path_t path;
+      auto *leaf = descend(key, &path);
+      auto pos = search<false>(leaf->keys, leaf->count, key);
+      if (pos == leaf->count || _comp(key, leaf->keys[pos]))
+        return 0;
+      erase_at(path, leaf, pos);
+      return 1;
+    }
+    size_type erase(Data const &key) { return erase<Data>(key); }
+    /** @brief erase removes the key under \a pos, and returns the iterator to the next one. */
+    iterator erase(iterator pos) {
+      path_t path;
+      auto *leaf = descend(*pos, &path);
+      assert(leaf == pos.leaf());
+      return erase_at(path, leaf, pos.index());
+    }
+    /** @brief erase removes the keys in [first, last). */
+    iterator erase(iterator first, iterator last) {
+      if (first == begin() && last == end()) {
+        clear();
+        return end();
+      }
+      // the erasures move the keys around, count them first
+      for (auto n = std::distance(first, last); n > 0; n--)
+        first = erase(first);
+      return first;
+    }
+
+  private:
+    void steal(btree &o) noexcept {
+      _root = o._root, _first = o._first, _last = o._last;
+      _size = o._size, _height = o._height;
+      _leaf_alloc = std::move(o._leaf_alloc);
+      _inner_alloc = std::move(o._inner_alloc);
+      _comp = std::move(o._comp);
+      o._root = nullptr, o._first = o._last = nullptr;
+      o._size = o._height = 0;
+    }
+
+    iterator at(leaf_node *leaf, size_type pos) const {
+      if (pos == leaf->count)
+        return iterator{leaf->next, 0, this};
+      return iterator{leaf, pos, this};
+    }
+
+    static constexpr unsigned char popcount4[16] = {0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4};
+
+    // search returns the count of the keys before \a key: the keys less
+    // than it, or when Upper the keys not greater than it. An arithmetic
+    // key under std::less counts them all without a branch.
+    template<bool Upper, typename K>
+    size_type search(Data const *keys, size_type n, K const &key) const {
+      constexpr bool counting = std::is_arithmetic_v<Data> && std::is_same_v<K, Data> &&
+                                (std::is_same_v<Compare, std::less<Data>> || std::is_same_v<Compare, std::less<>>);
+      if constexpr (counting) {
+        size_type i{}, r{};
+#if defined(__SSE2__)
+        if constexpr (std::is_same_v<Data, std::int32_t>) {
+          __m128i k = _mm_set1_epi32(key);
+          for (; i + 4 <= n; i += 4) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<__m128i const *>(keys + i));
+            __m128i m = Upper ? _mm_cmpgt_epi32(v, k) : _mm_cmplt_epi32(v, k);
+            r += popcount4[_mm_movemask_ps(_mm_castsi128_ps(m))];
+          }
+          if constexpr (Upper)
+            r = i - r;
+        }
+#endif
+        for (; i < n; i++)
+          r += Upper ? !(key < keys[i]) : (keys[i] < key);
+        return r;
+      } else if constexpr (Upper) {
+        return size_type(std::upper_bound(keys, keys + n, key, _comp) - keys);
+      } else {
+        return size_type(std::lower_bound(keys, keys + n, key, _comp) - keys);
+      }
+    }
+
+    // descend returns the leaf where \a key is or would go, recording the way down in \a path
+    template<typename K>
+    leaf_node *descend(K const &key, path_t *path) const {
+      auto *p = _root;
+      while (!p->is_leaf) {
+        auto *in = static_cast<inner_node *>(p);
+        auto i = search<true>(in->keys, in->count, key);
+        if (path) {
+          path->node[path->depth] = in;
+          path->index[path->depth++] = i;
+        }
+        p = in->children[i];
+      }
+      return static_cast<leaf_node *>(p);
+    }
+
+    template<typename V>
+    std::pair<iterator, bool> insert_unique(Data const &key, V &&v) {
+      if (!_root) {
+        auto *leaf = create<leaf_node>(_leaf_alloc);
+        leaf->keys[0] = std::forward<V>(v);
+        leaf->count = 1;
+        _root = _first = _last = leaf;
+        _size = _height = 1;
+        return {iterator{leaf, 0, this}, true};
+      }
+
+      path_t path;
+      auto *leaf = descend(key, &path);
+      size_type pos = search<false>(leaf->keys, leaf->count, key);
+      if (pos < leaf->count && !_comp(key, leaf->keys[pos]))
+        return {iterator{leaf, pos, this}, false};
+      _size++;
+
+      if (leaf->count < leaf_capacity) {
+        insert_at(leaf->keys, leaf->count, pos, std::forward<V>(v));
+        leaf->count++;
+        return {iterator{leaf, pos, this}, true};
+      }
+
+      // splits the full leaf; an append to the last leaf leaves it full,
+      // so the sorted loads fill the leaves up
+      auto *right = create<leaf_node>(_leaf_alloc);
+      size_type mid = (pos == leaf->count && !leaf->next) ? leaf->count : leaf->count / 2;
+      std::move(leaf->keys + mid, leaf->keys + leaf->count, right->keys);
+      right->count = leaf->count - (std::uint32_t) mid;
+      leaf->count = (std::uint32_t) mid;
+      right->next = leaf->next, right->prev = leaf;
+      (leaf->next ? leaf->next->prev : _last) = right;
+      leaf->next = right;
+
+      iterator ret;
+      if (pos < mid) {
+        insert_at(leaf->keys, leaf->count++, pos, std::forward<V>(v));
+        ret = iterator{leaf, pos, this};
+      } else {
+        insert_at(right->keys, right->count++, pos - mid, std::forward<V>(v));
+        ret = iterator{right, pos - mid, this};
+      }
+      insert_up(path, right->keys[0], right);
+      return {ret, true};
+    }
+
+    // hangs \a right, split from the child at the end of \a path, with its separator \a key
+    void insert_up(path_t &path, Data const &key, node_base *right) {
+      Data sep{key};
+      while (path.depth > 0) {
+        auto *in = path.node[--path.depth];
+        auto ci = path.index[path.depth];
+        if (in->count < inner_capacity) {
+          insert_child(in, ci, std::move(sep), right);
+          return;
+        }
+
+        // splits the full inner node: the keys and the new one are laid
+        // out in order, the middle one goes up and each half keeps the
+        // minimal fill
+        auto *r = create<inner_node>(_inner_alloc);
+        size_type n = in->count;
+        Data keys[inner_capacity + 1];
+        node_base *children[inner_capacity + 2];
+        std::move(in->keys, in->keys + ci, keys);
+        keys[ci] = std::move(sep);
+        std::move(in->keys + ci, in->keys + n, keys + ci + 1);
+        std::copy(in->children, in->children + ci + 1, children);
+        children[ci + 1] = right;
+        std::copy(in->children + ci + 1, in->children + n + 1, children + ci + 2);
+
+        size_type h = (n + 1) / 2;
+        std::move(keys, keys + h, in->keys);
+        std::copy(children, children + h + 1, in->children);
+        in->count = (std::uint32_t) h;
+        std::move(keys + h + 1, keys + n + 1, r->keys);
+        std::copy(children + h + 1, children + n + 2, r->children);
+        r->count = (std::uint32_t) (n - h);
+        sep = std::move(keys[h]);
+        right = r;
+      }
+
+      // the root split, the tree grows by a level
+      auto *root = create<inner_node>(_inner_alloc);
+      root->keys[0] = std::move(sep);
+      root->children[0] = _root;
+      root->children[1] = right;
+      root->count = 1;
+      _root = root;
+      _height++;
+    }
+
+    static void insert_child(inner_node *in, size_type ci, Data &&sep, node_base *right) {
+      insert_at(in->keys, in->count, ci, std::move(sep));
+      std::copy_backward(in->children + ci + 1, in->children + in->count + 1, in->children + in->count + 2);
+      in->children[ci + 1] = right;
+      in->count++;
+    }
+    template<typename V>
+    static void insert_at(Data *keys, size_type n, size_type pos, V &&v) {
+      std::move_backward(keys + pos, keys + n, keys + n + 1);
+      keys[pos] = std::forward<V>(v);
+    }
+    static void remove_at(Data *keys, size_type n, size_type pos) {
+      std::move(keys + pos + 1, keys + n, keys + pos);
+      keys[n - 1] = Data{};
+    }
+
+    // removes the key at \a pos of \a leaf and rebalances the way up;
+    // returns the iterator to the next key, wherever it went
+    iterator erase_at(path_t &path, leaf_node *leaf, size_type pos) {
+      remove_at(leaf->keys, leaf->count--, pos);
+      _size--;
+
+      if (path.depth == 0) { // the leaf is the root
+        if (leaf->count == 0) {
+          destroy(leaf);
+          _root = _first = _last = nullptr;
+          _height = 0;
+          return end();
+        }
+        return at(leaf, pos);
+      }
+      if (leaf->count >= min_leaf)
+        return at(leaf, pos);
+
+      auto *parent = path.node[path.depth - 1];
+      auto ci = path.index[path.depth - 1];
+      auto *left = ci > 0 ? static_cast<leaf_node *>(parent->children[ci - 1]) : nullptr;
+      auto *right = ci < parent->count ? static_cast<leaf_node *>(parent->children[ci + 1]) : nullptr;
+
+      if (left && left->count > min_leaf) { // borrows the last key of the left sibling
+        insert_at(leaf->keys, leaf->count++, 0, std::move(left->keys[left->count - 1]));
+        left->keys[--left->count] = Data{};
+        parent->keys[ci - 1] = leaf->keys[0];
+        return at(leaf, pos + 1);
+      }
+      if (right && right->count > min_leaf) { // borrows the first key of the right sibling
+        leaf->keys[leaf->count++] = std::move(right->keys[0]);
+        remove_at(right->keys, right->count--, 0);
+        parent->keys[ci] = right->keys[0];
+        return at(leaf, pos);
+      }
+
+      iterator ret;
+      if (left) { // merges the leaf into its left sibling
+        auto base = left->count;
+        merge_leaves(left, leaf);
+        ret = at(left, base + pos);
+        remove_child(parent, ci - 1);
+      } else {
+        merge_leaves(leaf, right);
+        ret = at(leaf, pos);
+        remove_child(parent, ci);
+      }
+      path.depth--;
+      rebalance_up(path, parent);
+      return ret;
+    }
+
+    void merge_leaves(leaf_node *left, leaf_node *right) {
+      std::move(right->keys, right->keys + right->count, left->keys + left->count);
+      left->count += right->count;
+      left->next = right->next;
+      (right->next ? right->next->prev : _last) = left;
+      destroy(right);
+    }
+    // removes the key i and the child i + 1 of \a in
+    static void remove_child(inner_node *in, size_type i) {
+      remove_at(in->keys, in->count, i);
+      std::copy(in->children + i + 2, in->children + in->count + 1, in->children + i + 1);
+      in->count--;
+    }
+
+    // fixes an inner node which may have too few keys, then its parents
+    void rebalance_up(path_t &path, inner_node *in) {
+      while (path.depth > 0) {
+        if (in->count >= min_inner)
+          return;
+        auto *parent = path.node[path.depth - 1];
+        auto ci = path.index[path.depth - 1];
+        auto *left = ci > 0 ? static_cast<inner_node *>(parent->children[ci - 1]) : nullptr;
+        auto *right = ci < parent->count ? static_cast<inner_node *>(parent->children[ci + 1]) : nullptr;
+
+        if (left && left->count > min_inner) { // rotates through the parent
+          insert_at(in->keys, in->count, 0, std::move(parent->keys[ci - 1]));
+          std::copy_backward(in->children, in->children + in->count + 1, in->children + in->count + 2);
+          in->children[0] = left->children[left->count];
+          in->count++;
+          parent->keys[ci - 1] = std::move(left->keys[left->count - 1]);
+          left->count--;
+          return;
+        }
+        if (right && right->count > min_inner) {
+          in->keys[in->count] = std::move(parent->keys[ci]);
+          in->children[in->count + 1] = right->children[0];
+          in->count++;
+          parent->keys[ci] = std::move(right->keys[0]);
+          remove_at(right->keys, right->count, 0);
+          std::copy(right->children + 1, right->children + right->count + 1, right->children);
+          right->count--;
+          return;
+        }
+
+        if (left) {
+          merge_inners(left, in, std::move(parent->keys[ci - 1]));
+          remove_child(parent, ci - 1);
+        } else {
+          merge_inners(in, right, std::move(parent->keys[ci]));
+          remove_child(parent, ci);
+        }
+        in = parent;
+        path.depth--;
+      }
+
+      // the root lost its last key, the tree shrinks by a level
+      if (in == _root && in->count == 0) {
+        _root = in->children[0];
+        destroy(in);
+        _height--;
+      }
+    }
+    void merge_inners(inner_node *left, inner_node *right, Data &&sep) {
+      left->keys[left->count] = std::move(sep);
+      std::move(right->keys, right->keys + right->count, left->keys + left->count + 1);
+      std::copy(right->children, right->children + right->count + 1, left->children + left->count + 1);
+      left->count += right->count + 1;
+      destroy(right);
+    }
+
+    template<typename N, typename A>
+    N *create(A &alloc) {
+      using traits = std::allocator_traits<A>;
+      N *p = traits::allocate(alloc, 1);
+      try {
+        ::new ((void *) p) N{};
+      } catch (...) {
+        traits::deallocate(alloc, p, 1);
+        throw;
+      }
+      p->is_leaf = std::is_same_v<N, leaf_node>;
+      return p;
+    }
+    void destroy(node_base *p) {
+      if (p->is_leaf) {
+        auto *leaf = static_cast<leaf_node *>(p);
+        leaf->~leaf_node();
+        std::allocator_traits<leaf_allocator>::deallocate(_leaf_alloc, leaf, 1);
+      } else {
+        auto *in = static_cast<inner_node *>(p);
+        in->~inner_node();
+        std::allocator_traits<inner_allocator>::deallocate(_inner_alloc, in, 1);
+      }
+    }
+    // the recursion is only as deep as the height, a few levels
+    void destroy_subtree(node_base *p) {
+      if (!p->is_leaf) {
+        auto *in = static_cast<inner_node *>(p);
+        for (size_type i = 0; i <= in->count; i++)
+          destroy_subtree(in->children[i]);
+      }
+      destroy(p);
+    }
+  };
+
+} // namespace dp::tree
+
+// --------------------------------------- concurrent_skip_list
+namespace dp::tree::detail {
+
+  /**
+   * @brief grace_period lets the readers walk shared nodes without a lock
+   * while the writers unlink them, and tells when the unlinked nodes can
+   * be freed.
+   * @details A reader enters by counting itself in the current parity,
+   * spread on a few stripes to keep the readers off a single cache line.
+   * synchronize() flips the parity and waits until the readers of the old
+   * one are gone: nothing unlinked before the flip is reachable anymore.
+   * The readers never wait; synchronize() must not be called by a thread
+   * inside a read section, see in_read_section().
+   */
+  class grace_period {
+  public:
+    static constexpr std::size_t stripes = 16;
+
+    std::size_t enter() {
+      auto &s = _stripes[stripe()];
+      for (;;) {
+        auto p = _parity.load();
+        s.readers[p].fetch_add(1);
+        if (_parity.load() == p) {
+          depth()++;
+          return p;
+        }
+        s.readers[p].fetch_sub(1); // a flip sneaked in, counts again in the new parity
+      }
+    }
+    void leave(std::size_t p) {
+      depth()--;
+      _stripes[stripe()].readers[p].fetch_sub(1);
+    }
+
+    void synchronize() {
+      std::lock_guard<std::mutex> l{_m};
+      auto old = _parity.load();
+      _parity.store(old ^ 1);
+      for (auto &s : _stripes)
+        while (s.readers[old].load() != 0)
+          std::this_thread::yield();
+    }
+
+    /** @brief in_read_section tells whether the calling thread is inside a read section, of any grace_period. */
+    static bool in_read_section() { return depth() != 0; }
+
+    /** @brief a read section, as a RAII object. */
+    class reader {
+    public:
+      explicit reader(grace_period &gp)
+          : _gp(gp)
+          , _p(gp.enter()) {}
+      ~reader() { _gp.leave(_p); }
+      reader(reader const &) = delete;
+      reader &operator=(reader const &) = delete;
+
+    private:
+      grace_period &_gp;
+      std::size_t _p;
+    };
+
+  private:
+    static std::size_t stripe() {
+      static std::atomic<std::size_t> next{};
+      thread_local std::size_t s = next.fetch_add(1, std::memory_order_relaxed) % stripes;
+      return s;
+    }
+    static std::size_t &depth() {
+      thread_local std::size_t d{};
+      return d;
+    }
+
+    struct alignas(64) stripe_t {
+      std::atomic<std::int64_t> readers[2]{};
+    };
+    stripe_t _stripes[stripes]{};
+    std::atomic<std::size_t> _parity{};
+    std::mutex _m{};
+  };
+
+} // namespace dp::tree::detail
+
+namespace dp::tree {
+
+  /**
+   * @brief concurrent_skip_list is an ordered set of unique keys, safe to
+   * use from many threads at once.
+   *
+   * It is a lazy skip list: the lookups and the range scans take no lock
+   * and never wait, an insert or an erase locks only the few nodes around
+   * its key. An erased node is marked, unlinked, then put on a retire
+   * list; the list is freed in batches once no reader can still see its
+   * nodes (see detail::grace_period).
+   *
+   * The keys are never handed out by reference outside a read section:
+   * visit(), for_each() and range() call a visitor with each key, which
+   * may return false to stop; lower_bound() returns a copy. The visitor
+   * must not insert or erase in the same list. size() is exact when the
+   * writers are quiet. clear() and the destructor need exclusive access.
+   *
+   * @code{c++}
+   * dp::tree::concurrent_skip_list&lt;int&gt; s;
+   * // any threads
+   * s.insert(7);
+   * s.erase(3);
+   * bool has = s.contains(7);
+   * s.range(0, 100, [](int const &k) { use(k); });
+   * @endcode
+   */
+  template<typename Data, typename Compare = std::less<Data>>
+  class concurrent_skip_list {
+  public:
+    using size_type = std::size_t;
+    using key_type = Data;
+    using value_type = Data;
+    using key_compare = Compare;
+
+    static constexpr int max_level = 24;
+
+    concurrent_skip_list() { _head = create_node(max_level - 1); }
+    explicit concurrent_skip_list(Compare const &comp)
+        : concurrent_skip_list() { _comp = comp; }
+    concurrent_skip_list(concurrent_skip_list const &) = delete;
+    concurrent_skip_list &operator=(concurrent_skip_list const &) = delete;
+    ~concurrent_skip_list() {
+      clear();
+      destroy_node(_head);
+    }
+
+  private:
+    // aligned for the links laid out after it
+    struct alignas(std::atomic<void *>) node {
+      Data key;
+      int top_level;
+      std::atomic<bool> marked{};
+      std::atomic<bool> fully_linked{};
+      std::atomic<bool> locked{};
+
+      template<typename... Args>
+      node(int top, Args &&...args)
+          : key(std::forward<Args>(args)...)
+          , top_level(top) {}
+      // the forward links, one per level, are laid out right after the node
+      std::atomic<node *> *next() { return reinterpret_cast<std::atomic<node *> *>(this + 1); }
+
+      void lock() {
+        while (locked.exchange(true, std::memory_order_acquire))
+          std::this_thread::yield();
+      }
+      void unlock() { locked.store(false, std::memory_order_release); }
+    };
+
+    using NodePtr = node *;
+    using read_section = detail::grace_period::reader;
+    static constexpr size_type retire_batch = 256;
+
+    NodePtr _head{};
+    Compare _comp{};
+    std::atomic<size_type> _size{};
+    mutable detail::grace_period _gp{};
+    std::mutex _retired_m{};
+    std::vector<NodePtr> _retired{};
+
+    template<typename K>
+    using lookup_t = std::enable_if_t<std::is_same_v<K, Data> || detail::is_transparent<Compare>::value>;
+
+  public:
+    size_type size() const { return _size.load(std::memory_order_relaxed); }
+    size_type count() const { return size(); }
+    bool empty() const { return size() == 0; }
+    key_compare key_comp() const { return _comp; }
+
+    /** @brief clear removes all the keys; no other thread may use the list meanwhile. */
+    void clear() {
+      for (NodePtr p = _head->next()[0].load(), next; p; p = next) {
+        next = p->next()[0].load();
+        destroy_node(p);
+      }
+      for (int i = 0; i < max_level; i++)
+        _head->next()[i].store(nullptr);
+      for (auto *p : _retired)
+        destroy_node(p);
+      _retired.clear();
+      _size = 0;
+    }
+
+    template<typename K, typename = lookup_t<K>>
+    bool contains(K const &key) const {
+      read_section rs{_gp};
+      auto *p = find_node(key);
+      return p && p->fully_linked.load(std::memory_order_acquire) && !p->marked.load(std::memory_order_acquire);
+    }
+    bool contains(Data const &key) const { return contains<Data>(key); }
+
+    /** @brief visit calls \a fn with the key equal to \a key, if any, and tells whether it was found. */
+    template<typename K, typename F, typename = lookup_t<K>>
+    bool visit(K const &key, F &&fn) const {
+      read_section rs{_gp};
+      auto *p = find_node(key);
+      if (!p || !p->fully_linked.load(std::memory_order_acquire) || p->marked.load(std::memory_order_acquire))
+        return false;
+      fn(static_cast<Data const &>(p->key));
+      return true;
+    }
+
+    /** @brief lower_bound returns a copy of the first key not less than \a key. */
+    template<typename K, typename = lookup_t<K>>
+    std::optional<Data> lower_bound(K const &key) const {
+      std::optional<Data> ret;
+      range_from(key, [&ret](Data const &k) { ret.emplace(k); return false; });
+      return ret;
+    }
+    std::optional<Data> lower_bound(Data const &key) const { return lower_bound<Data>(key); }
+
+    /** @brief for_each visits all the keys in order. */
+    template<typename F>
+    void for_each(F &&fn) const {
+      read_section rs{_gp};
+      walk(_head->next()[0].load(std::memory_order_acquire), fn);
+    }
+    /** @brief range visits the keys in [lo, hi) in order. */
+    template<typename K, typename F, typename = lookup_t<K>>
+    void range(K const &lo, K const &hi, F &&fn) const {
+      range_from(lo, [this, &hi, &fn](Data const &k) {
+        if (!_comp(k, hi)) return false;
+        return visit_key(fn, k);
+      });
+    }
+
+  public:
+    /** @brief insert adds \a v unless its key exists, and tells whether it was added. */
+    bool insert(Data const &v) { return add(v, v); }
+    bool insert(Data &&v) { return add(v, std::move(v)); }
+    /** @brief emplace builds the key from \a args, then inserts it by move. */
+    template<typename... Args>
+    bool emplace(Args &&...args) {
+      if constexpr (std::is_constructible_v<Data, Args &&...>) {
+        Data key(std::forward<Args>(args)...);
+        return add(key, std::move(key));
+      } else {
+        Data key{std::forward<Args>(args)...};
+        return add(key, std::move(key));
+      }
+    }
+
+    /** @brief erase removes \a key, and tells whether it was there. */
+    template<typename K, typename = lookup_t<K>>
+    bool erase(K const &key) {
+      bool erased;
+      {
+        read_section rs{_gp};
+        erased = remove(key);
+      }
+      if (erased)
+        maybe_reclaim();
+      return erased;
+    }
+    bool erase(Data const &key) { return erase<Data>(key); }
+
+    /** @brief reclaim frees the erased nodes no reader can still see; erase() calls it by itself every few hundred erasures. */
+    void reclaim() {
+      if (detail::grace_period::in_read_section())
+        return; // it would wait for the reader we are
+      std::vector<NodePtr> batch;
+      {
+        std::lock_guard<std::mutex> l{_retired_m};
+        batch.swap(_retired);
+      }
+      if (batch.empty())
+        return;
+      _gp.synchronize();
+      for (auto *p : batch)
+        destroy_node(p);
+    }
+
+  private:
+    static int random_level() {
+      thread_local std::uint64_t x = 0x9E3779B97F4A7C15ull ^ (std::uint64_t) (std::uintptr_t) &x;
+      x ^= x << 13, x ^= x >> 7, x ^= x << 17;
+      int level = 0; // a level more with a chance of 1/4
+      for (auto bits = x; level < max_level - 1 && (bits & 3) == 0; bits >>= 2)
+        level++;
+      return level;
+    }
+
+    template<typename... Args>
+    static NodePtr create_node(int top, Args &&...args) {
+      void *mem = ::operator new(sizeof(node) + sizeof(std::atomic<NodePtr>) * (top + 1));
+      NodePtr p;
+      try {
+        p = ::new (mem) node(top, std::forward<Args>(args)...);
+      } catch (...) {
+        ::operator delete(mem);
+        throw;
+      }
+      for (int i = 0; i <= top; i++)
+        ::new ((void *) (p->next() + i)) std::atomic<NodePtr>{nullptr};
+      return p;
+    }
+    static void destroy_node(NodePtr p) {
+      p->~node();
+      ::operator delete((void *) p);
+    }
+
+    template<typename F>
+    static bool visit_key(F &fn, Data const &k) {
+      if constexpr (std::is_convertible_v<std::invoke_result_t<F &, Data const &>, bool>)
+        return fn(k);
+      else {
+        fn(k);
+        return true;
+      }
+    }
+    // visits the live nodes from \a p on
+    template<typename F>
+    static void walk(NodePtr p, F &fn) {
+      for (; p; p = p->next()[0].load(std::memory_order_acquire))
+        if (p->fully_linked.load(std::memory_order_acquire) && !p->marked.load(std::memory_order_acquire))
+          if (!visit_key(fn, p->key))
+            return;
+    }
+    template<typename K, typename F>
+    void range_from(K const &lo, F &&fn) const {
+      read_section rs{_gp};
+      NodePtr pred = _head, curr{};
+      for (int level = max_level - 1; level >= 0; level--) {
+        curr = pred->next()[level].load(std::memory_order_acquire);
+        while (curr && _comp(curr->key, lo)) {
+          pred = curr;
+          curr = pred->next()[level].load(std::memory_order_acquire);
+        }
+      }
+      walk(curr, fn);
+    }
+
+    // find_node returns the node holding \a key, live or not
+    template<typename K>
+    NodePtr find_node(K const &key) const {
+      NodePtr pred = _head;
+      for (int level = max_level - 1; level >= 0; level--) {
+        auto *curr = pred->next()[level].load(std::memory_order_acquire);
+        while (curr && _comp(curr->key, key)) {
+          pred = curr;
+          curr = pred->next()[level].load(std::memory_order_acquire);
+        }
+        if (curr && !_comp(key, curr->key))
+          return curr;
+      }
+      return nullptr;
+    }
+    // find fills the predecessors and the successors of \a key at each
+    // level, and returns the highest level where the key was found, or -1
+    template<typename K>
+    int find(K const &key, NodePtr *preds, NodePtr *succs) const {
+      int found = -1;
+      NodePtr pred = _head;
+      for (int level = max_level - 1; level >= 0; level--) {
+        auto *curr = pred->next()[level].load(std::memory_order_acquire);
+        while (curr && _comp(curr->key, key)) {
+          pred = curr;
+          curr = pred->next()[level].load(std::memory_order_acquire);
+        }
+        if (found == -1 && curr && !_comp(key, curr->key))
+          found = level;
+        preds[level] = pred;
+        succs[level] = curr;
+      }
+      return found;
+    }
+    static void unlock_preds(NodePtr *preds, int highest) {
+      NodePtr prev{};
+      for (int level = 0; level <= highest; level++)
+        if (preds[level] != prev)
+          prev = preds[level], prev->unlock();
+    }
+
+    template<typename V>
+    bool add(Data const &key, V &&v) {
+      int top = random_level();
+      NodePtr preds[max_level], succs[max_level];
+      read_section rs{_gp};
+      for (;;) {
+        int found = find(key, preds, succs);
+        if (found != -1) {
+          auto *p = succs[found];
+          if (!p->marked.load(std::memory_order_acquire)) {
+            while (!p->fully_linked.load(std::memory_order_acquire))
+              std::this_thread::yield();
+            return false;
+          }
+          continue; // being erased, tries again once it is unlinked
+        }
+
+        int highest = -1;
+        bool valid = true;
+        NodePtr prev{};
+        for (int level = 0; valid && level <= top; level++) {
+          auto *pred = preds[level], *succ = succs[level];
+          if (pred != prev) {
+            pred->lock();
+            highest = level, prev = pred;
+          }
+          valid = !pred->marked.load() && (!succ || !succ->marked.load()) && pred->next()[level].load() == succ;
+        }
+        if (!valid) {
+          unlock_preds(preds, highest);
+          continue;
+        }
+
+        NodePtr p;
+        try {
+          p = create_node(top, std::forward<V>(v));
+        } catch (...) {
+          unlock_preds(preds, highest);
+          throw;
+        }
+        for (int level = 0; level <= top; level++)
+          p->next()[level].store(succs[level], std::memory_order_relaxed);
+        for (int level = 0; level <= top; level++)
+          preds[level]->next()[level].store(p, std::memory_order_release);
+        p->fully_linked.store(true, std::memory_order_release);
+        unlock_preds(preds, highest);
+        _size.fetch_add(1, std::memory_order_relaxed);
+        return true;
+      }
+    }
+
+    template<typename K>
+    bool remove(K const &key) {
+      NodePtr preds[max_level], succs[max_level];
+      NodePtr victim{};
+      int top = -1;
+      for (;;) {
+        int found = find(key, preds, succs);
+        if (!victim) {
+          if (found == -1)
+            return false;
+          auto *p = succs[found];
+          // only a fully linked node, found at its top level, and not being erased
+          if (!p->fully_linked.load(std::memory_order_acquire) || p->top_level != found || p->marked.load(std::memory_order_acquire))
+            return false;
+          victim = p, top = p->top_level;
+          victim->lock();
+          if (victim->marked.load()) {
+            victim->unlock();
+            return false;
+          }
+          victim->marked.store(true, std::memory_order_release);
+        }
+
+        int highest = -1;
+        bool valid = true;
+        NodePtr prev{};
+        for (int level = 0; valid && level <= top; level++) {
+          auto *pred = preds[level];
+          if (pred != prev) {
+            pred->lock();
+            highest = level, prev = pred;
+          }
+          valid = !pred->marked.load() && pred->next()[level].load() == victim;
+        }
+        if (!valid) {
+          unlock_preds(preds, highest);
+          continue;
+        }
+
+        for (int level = top; level >= 0; level--)
+          preds[level]->next()[level].store(victim->next()[level].load(std::memory_order_relaxed), std::memory_order_release);
+        victim->unlock();
+        unlock_preds(preds, highest);
+        _size.fetch_sub(1, std::memory_order_relaxed);
+        {
+          std::lock_guard<std::mutex> l{_retired_m};
+          _retired.push_back(victim);
+        }
+        return true;
+      }
+    }
+
+    void maybe_reclaim() {
+      {
+        std::lock_guard<std::mutex> l{_retired_m};
+        if (_retired.size() < retire_batch)
+          return;
+      }
+      reclaim();
+    }
+  };
 
 } // namespace dp::tree
 
@@ -575,6 +2601,7 @@ namespace dp::tree {
     private:
       Data _data{};
       NodePtr _parent{nullptr};
+      size_type _index{}; // position in _parent->_children
       Nodes _children{};
 
     public:
@@ -612,32 +2639,33 @@ namespace dp::tree {
       }
 
     public:
-      void insert(Data const &val) {
-        auto item = new Node{val}; //std::make_unique<Node>(val);
-        item->_parent = this;
-        _children.push_back(std::move(item));
-      }
-      void insert(Data &&val) {
-        auto item = new Node{val}; //std::make_unique<Node>(val);
-        item->_parent = this;
-        _children.push_back(std::move(item));
-        // children.emplace_back(val);
-      }
+      void insert(Data const &val) { adopt(new Node{val}); }
+      void insert(Data &&val) { adopt(new Node{std::move(val)}); }
       template<typename... Args>
       void emplace(Args &&...args) {
-        auto item = new Node{std::forward<Args>(args)...}; // std::make_unique<Node>(std::forward<Args>(args)...);
-        item->_parent = this;
-        _children.push_back(std::move(item));
-        // children.emplace_back(std::forward<Args>(args)...);
+        adopt(new Node{std::forward<Args>(args)...}); // std::make_unique<Node>(std::forward<Args>(args)...);
       }
       void erase(size_type index) {
-        _children.erase(index);
+        delete _children[index];
+        _children.erase(_children.begin() + std::ptrdiff_t(index));
+        for (; index < _children.size(); ++index)
+          _children[index]->_index = index;
+      }
+
+    private:
+      void adopt(NodePtr item) {
+        item->_parent = this;
+        item->_index = _children.size();
+        _children.push_back(item);
       }
 
     public:
       /**
-             * @brief preorder = parent -> left -> right. preorder_iter walks the whole tree with parent first and children followed.
-             */
+       * @brief preorder = parent -> left -> right. preorder_iter_data walks the
+       * subtree it was begun at with parent first and children followed.
+       * Each step is amortized O(1): a node knows its position among its
+       * siblings, so moving on from a leaf needs no search of the parent.
+       */
       struct preorder_iter_data {
 
         // iterator traits
@@ -651,17 +2679,11 @@ namespace dp::tree {
         using const_reference = value_type const &;
 
         preorder_iter_data() {}
-        preorder_iter_data(pointer ptr_, bool invalid_ = false)
-            : _ptr(ptr_), _invalid(invalid_) {}
-        preorder_iter_data(const preorder_iter_data &o)
-            : _ptr(o._ptr), _invalid(o._invalid) {}
-        preorder_iter_data &operator=(const preorder_iter_data &o) {
-          _ptr = o._ptr, _invalid = o._invalid;
-          return *this;
-        }
+        preorder_iter_data(pointer ptr_, const_pointer root_)
+            : _ptr(ptr_), _root(root_) {}
 
-        bool operator==(self const &r) const { return _ptr == r._ptr && _invalid == r._invalid; }
-        bool operator!=(self const &r) const { return _ptr != r._ptr || _invalid != r._invalid; }
+        bool operator==(self const &r) const { return _ptr == r._ptr; }
+        bool operator!=(self const &r) const { return _ptr != r._ptr; }
         reference data() { return *_ptr; }
         const_reference data() const { return *_ptr; }
         reference operator*() { return data(); }
@@ -670,62 +2692,33 @@ namespace dp::tree {
         const_pointer operator->() const { return &(data()); }
         self &operator++() { return _incr(); }
         self operator++(int) {
-          self copy{_ptr, _invalid};
+          self copy{*this};
           ++(*this);
           return copy;
         }
 
-        static self begin(const_pointer root_) {
-          return self{const_cast<pointer>(root_)};
-        }
-        static self end(const_pointer root_) {
-          if (root_ == nullptr) return self{const_cast<pointer>(root_)};
-          pointer p = const_cast<pointer>(root_), last{nullptr};
-          while (p) {
-            last = p;
-            if (p->empty())
-              break;
-            p = &((*p)[p->size() - 1]);
-          }
-          auto it = self{last, true};
-          ++it;
-          return it;
-        }
+        static self begin(const_pointer root_) { return self{const_cast<pointer>(root_), root_}; }
+        static self end(const_pointer root_) { return self{nullptr, root_}; }
 
       private:
         self &_incr() {
-          if (_invalid) {
+          if (_ptr->has_children()) {
+            _ptr = _ptr->_children.front();
             return (*this);
           }
-
-          auto *cc = _ptr;
-          if (cc->empty()) {
-            Node *pp = cc;
-            size_type idx;
-          go_up_level:
-            pp = pp->parent();
-            idx = 0;
-            for (auto *vv : pp->_children) {
-              ++idx;
-              if (vv == _ptr) break;
-            }
-            if (idx < pp->size()) {
-              _ptr = &((*pp)[idx]);
-            } else {
-              if (pp->parent()) {
-                goto go_up_level;
-              }
-              _invalid = true;
+          // climb until a node of the subtree has a next sibling
+          for (pointer cc = _ptr; cc != _root && cc->_parent; cc = cc->_parent) {
+            if (cc->_index + 1 < cc->_parent->size()) {
+              _ptr = cc->_parent->_children[cc->_index + 1];
+              return (*this);
             }
-          } else {
-            _ptr = &((*cc)[0]);
           }
+          _ptr = nullptr;
           return (*this);
         }
 
         pointer _ptr{};
-        bool _invalid{};
-        // size_type _child_idx{};
+        const_pointer _root{};
       };
 
       using iterator = preorder_iter_data;
@@ -735,6 +2728,10 @@ namespace dp::tree {
       iterator end() { return iterator::end(this); }
       const_iterator end() const { return const_iterator::end(this); }
 
+      /**
+       * @brief rev_preorder_iter_data walks the subtree in the reverse of
+       * preorder, from its last descendant up to the node it was begun at.
+       */
       struct rev_preorder_iter_data {
 
         // iterator traits
@@ -748,95 +2745,45 @@ namespace dp::tree {
         using const_reference = value_type const &;
 
         rev_preorder_iter_data() {}
-        rev_preorder_iter_data(pointer ptr_, bool on_children_ = false, size_type idx_ = 0)
-            : _ptr(ptr_), _on_children(on_children_), _child_idx(idx_) {}
-        rev_preorder_iter_data(const rev_preorder_iter_data &o)
-            : _ptr(o._ptr), _on_children(o._on_children), _child_idx(o._child_idx) {}
-        rev_preorder_iter_data &operator=(const rev_preorder_iter_data &o) {
-          _ptr = o._ptr, _on_children = o._on_children, _child_idx = o._child_idx;
-          return *this;
-        }
+        rev_preorder_iter_data(pointer ptr_, const_pointer root_)
+            : _ptr(ptr_), _root(root_) {}
 
-        bool operator==(self const &r) const { return _ptr == r._ptr && _on_children == r._on_children && _child_idx == r._child_idx; }
-        bool operator!=(self const &r) const { return _ptr != r._ptr || _on_children != r._on_children || _child_idx != r._child_idx; }
-        reference data() const {
-          auto &ret = _ptr;
-          if (_on_children) {
-            if (ret->_children.empty() || _child_idx >= ret->_children.size())
-              return *ret;
-            return *(ret->_children[_child_idx]);
-          }
-          return *ret;
-        }
+        bool operator==(self const &r) const { return _ptr == r._ptr; }
+        bool operator!=(self const &r) const { return _ptr != r._ptr; }
+        reference data() const { return *_ptr; }
         reference operator*() { return data(); }
         const_reference operator*() const { return data(); }
         pointer operator->() { return &(data()); }
         const_pointer operator->() const { return &(data()); }
         self &operator++() { return _decr(); }
         self operator++(int) {
-          self copy{_ptr, _on_children, _child_idx};
+          self copy{*this};
           ++(*this);
           return copy;
         }
 
-        static self begin(pointer root_) {
-          if (root_) {
-            pointer p = root_, last{nullptr};
-            while (p) {
-              last = p;
-              if (p->_children.empty())
-                break;
-              p = (p->_children[p->_children.size() - 1]);
-            }
-            return self{last};
-          }
-          return self{root_};
-        }
-        static self end(pointer) {
-          return self{nullptr};
-        }
+        static self begin(const_pointer root_) { return self{last_descendant(const_cast<pointer>(root_)), root_}; }
+        static self end(const_pointer root_) { return self{nullptr, root_}; }
 
       private:
-        self &_decr() {
-          auto ret = _ptr;
-          auto idx = _child_idx;
-
-          if (_on_children) {
-            if (!(ret->_children.empty() || _child_idx <= 0)) {
-              _child_idx--;
-              return *this;
-            }
-            _on_children = false;
-            return *this;
-          }
-
-          if (ret->_parent) {
-            _ptr = ret->_parent;
-            _on_children = true;
-            _child_idx = 0;
-
-            for (auto *it : ret->_parent->_children) {
-              if (it == ret) break;
-              _child_idx++;
-            }
+        static pointer last_descendant(pointer p) {
+          while (p && p->has_children())
+            p = p->_children.back();
+          return p;
+        }
 
-            if (_child_idx <= 0) {
-              // end() ?
-              _ptr = ret;
-              _child_idx = idx;
-              _on_children = false;
-            } else
-              _child_idx--;
-          } else {
+        self &_decr() {
+          if (_ptr == _root || !_ptr->_parent)
             _ptr = nullptr;
-          }
-
+          else if (_ptr->_index > 0)
+            _ptr = last_descendant(_ptr->_parent->_children[_ptr->_index - 1]);
+          else
+            _ptr = _ptr->_parent;
           return (*this);
         }
 
         pointer _ptr{};
-        bool _on_children{};
-        size_type _child_idx{};
+        const_pointer _root{};
       };
 
       using reverse_iterator = rev_preorder_iter_data;
@@ -846,6 +2793,11 @@ namespace dp::tree {
       reverse_iterator rend() { return const_reverse_iterator::end(this); }
       const_reverse_iterator rend() const { return const_reverse_iterator::end(this); }
 
+      /**
+       * @brief children_first_iter_data walks the subtree in postorder, that is
+       * every node after all of its children. operator-- walks back, and from
+       * end() starts at the node the iterator was begun at.
+       */
       struct children_first_iter_data {
 
         // iterator traits
@@ -854,101 +2806,264 @@ namespace dp::tree {
         using pointer = value_type *;
         using reference = value_type &;
         using iterator_category = std::bidirectional_iterator_tag;
+        using const_pointer = value_type const *;
 
         children_first_iter_data() {}
-        children_first_iter_data(pointer ptr_, bool on_children_ = false, size_type idx_ = 0)
-            : _ptr(ptr_), _on_children(on_children_), _child_idx(idx_) {}
-        children_first_iter_data(const children_first_iter_data &o)
-            : _ptr(o._ptr), _on_children(o._on_children), _child_idx(o._child_idx) {}
-        children_first_iter_data &operator=(const children_first_iter_data &o) {
-          _ptr = o._ptr, _on_children = o._on_children, _child_idx = o._child_idx;
-          return *this;
-        }
+        children_first_iter_data(pointer ptr_, const_pointer root_)
+            : _ptr(ptr_), _root(root_) {}
 
-        bool operator==(children_first_iter_data const &r) const { return _ptr == r._ptr && _on_children == r._on_children && _child_idx == r._child_idx; }
-        bool operator!=(children_first_iter_data const &r) const { return _ptr != r._ptr || _on_children != r._on_children || _child_idx != r._child_idx; }
-        reference operator*() const {
-          auto &ret = _ptr;
-          if (_on_children) {
-            if (ret->_children.empty() || _child_idx >= ret->_children.size())
-              return *ret;
-            return *(ret->_children[_child_idx]);
-          }
-          return *ret;
-        }
+        bool operator==(children_first_iter_data const &r) const { return _ptr == r._ptr; }
+        bool operator!=(children_first_iter_data const &r) const { return _ptr != r._ptr; }
+        reference operator*() const { return *_ptr; }
+        pointer operator->() const { return _ptr; }
         children_first_iter_data &operator++() { return _incr(); }
         children_first_iter_data operator++(int) {
-          children_first_iter_data copy{_ptr, _on_children, _child_idx};
+          children_first_iter_data copy{*this};
           ++(*this);
           return copy;
         }
-        static children_first_iter_data begin(pointer root_) {
-          if (root_) {
-            pointer p = root_, last{nullptr};
-            while (p) {
-              last = p;
-              if (p->_children.empty())
-                break;
-              p = (p->_children[0]);
-            }
-            return children_first_iter_data{last, !last->_children.empty()};
-          }
-          return children_first_iter_data{root_};
+        children_first_iter_data &operator--() { return _decr(); }
+        children_first_iter_data operator--(int) {
+          children_first_iter_data copy{*this};
+          --(*this);
+          return copy;
+        }
+        static children_first_iter_data begin(const_pointer root_) {
+          return children_first_iter_data{first_descendant(const_cast<pointer>(root_)), root_};
         }
-        static children_first_iter_data end(pointer root_) {
-          // NodePtr p = root_, last{nullptr};
-          // while (p) {
-          //     last = p;
-          //     if (p->_children.empty())
-          //         break;
-          //     p = (p->_children[p->_children.size() - 1]);
-          // }
-          // return children_first_iter_data{last, !last->_children.empty()};
-          if (root_)
-            return children_first_iter_data{root_, false, root_->_children.size()};
-          return children_first_iter_data{root_};
+        static children_first_iter_data end(const_pointer root_) {
+          return children_first_iter_data{nullptr, root_};
         }
 
       private:
+        static pointer first_descendant(pointer p) {
+          while (p && p->has_children())
+            p = p->_children.front();
+          return p;
+        }
+
         children_first_iter_data &_incr() {
-          auto ret = _ptr;
-          auto idx = _child_idx;
+          if (_ptr == _root || !_ptr->_parent)
+            _ptr = nullptr;
+          else if (_ptr->_index + 1 < _ptr->_parent->size())
+            _ptr = first_descendant(_ptr->_parent->_children[_ptr->_index + 1]);
+          else
+            _ptr = _ptr->_parent;
+          return (*this);
+        }
 
-          if (_on_children) {
-            if (!(ret->_children.empty() || _child_idx >= ret->_children.size())) {
-              _child_idx++;
-              return *this;
+        children_first_iter_data &_decr() {
+          if (!_ptr) {
+            _ptr = const_cast<pointer>(_root);
+            return (*this);
+          }
+          if (_ptr->has_children()) {
+            _ptr = _ptr->_children.back();
+            return (*this);
+          }
+          // climb until a node of the subtree has a previous sibling
+          for (pointer cc = _ptr; cc != _root && cc->_parent; cc = cc->_parent) {
+            if (cc->_index > 0) {
+              _ptr = cc->_parent->_children[cc->_index - 1];
+              return (*this);
             }
-            _on_children = false;
-            return *this;
           }
+          _ptr = nullptr;
+          return (*this);
+        }
 
-          if (ret->_parent) {
-            _ptr = ret->_parent;
-            _on_children = true;
-            _child_idx = 0;
+        pointer _ptr{};
+        const_pointer _root{};
+      };
+    }; // struct generic_node_t
 
-            for (auto *it : ret->_parent->_children) {
-              _child_idx++;
-              if (it == ret) break;
-            }
+    /**
+     * @brief work_stealing_pool visits the nodes of a generic tree on a few
+     * threads, splitting the work at subtree boundaries.
+     *
+     * The pending work is kept as runs of siblings, in one deque per worker.
+     * A worker takes its next few nodes from the back of its own deque, so
+     * it walks depth first, and pushes the children of each one as one more
+     * run. An idle worker steals half of the run at the front of another
+     * deque, which holds the oldest and usually the biggest subtrees, so
+     * even the children of a single wide node spread over all the workers.
+     * The idle workers sleep until some work is pushed.
+     *
+     * The calling thread is worker 0. The others are started by each run()
+     * and joined before it returns, which costs some tens of microseconds
+     * per thread: for small trees the sequential walks are faster.
+     */
+    template<typename Node>
+    class work_stealing_pool {
+    public:
+      using NodePtr = Node *;
 
-            if (_child_idx >= ret->_parent->_children.size()) {
-              // end() ?
-              _ptr = ret;
-              _child_idx = idx;
-              _on_children = false;
+      explicit work_stealing_pool(unsigned threads = 0)
+          : _deques(threads ? threads : std::max(1u, std::thread::hardware_concurrency())) {}
+
+      unsigned size() const { return unsigned(_deques.size()); }
+
+      /**
+       * @brief run calls visit(worker, node) for each node below \a root, root
+       * included, until a call returns false. worker is in [0, size()), so
+       * visit can keep per-worker state without locking. An exception thrown
+       * by visit stops the run and is rethrown here.
+       */
+      template<typename Visit>
+      void run(NodePtr root, Visit &&visit) {
+        if (!root) return;
+        _stop = false;
+        _pending = 1;
+        _root = root;
+        _deques[0].push({nullptr, 0, 1});
+        std::vector<std::thread> threads;
+        for (unsigned w = 1; w < size(); ++w)
+          threads.emplace_back([this, w, &visit] { work(w, visit); });
+        work(0, visit);
+        for (auto &t : threads) t.join();
+        for (auto &d : _deques) d.clear();
+        if (_error) std::rethrow_exception(std::exchange(_error, nullptr));
+      }
+
+    private:
+      // the most nodes a worker takes from its deque at once, the rest stay there to be stolen
+      static constexpr std::size_t grain = 32;
+
+      // the children [b, e) of parent, or the root if parent is null
+      struct run_t {
+        NodePtr parent;
+        std::size_t b, e;
+      };
+
+      struct alignas(64) deque_t {
+        std::mutex m;
+        std::deque<run_t> q;
+        std::atomic<std::size_t> n{}; // q.size(), to skip the empty ones without locking
+
+        void push(run_t r) {
+          std::lock_guard<std::mutex> l{m};
+          q.push_back(r);
+          n = q.size();
+        }
+        // the owner takes the first few nodes of the last run
+        bool take(run_t &out) {
+          if (n == 0) return false;
+          std::lock_guard<std::mutex> l{m};
+          if (q.empty()) return false;
+          auto &r = q.back();
+          out = {r.parent, r.b, std::min(r.b + grain, r.e)};
+          if ((r.b = out.e) == r.e) {
+            q.pop_back();
+            n = q.size();
+          }
+          return true;
+        }
+        // a thief takes the upper half of the first run, away from the owner
+        bool steal(run_t &out) {
+          if (n == 0) return false;
+          std::lock_guard<std::mutex> l{m};
+          if (q.empty()) return false;
+          auto &r = q.front();
+          auto half = (r.e - r.b + 1) / 2;
+          out = {r.parent, r.e - half, r.e};
+          if ((r.e -= half) == r.b) {
+            q.pop_front();
+            n = q.size();
+          }
+          return true;
+        }
+        void clear() {
+          q.clear();
+          n = 0;
+        }
+      };
+
+      template<typename Visit>
+      void work(unsigned w, Visit &visit) {
+        auto &own = _deques[w];
+        std::size_t done{}; // the nodes visited but not yet taken off _pending
+        run_t r;
+        while (!_stop) {
+          if (!own.take(r)) {
+            if (done && (_pending -= std::exchange(done, 0)) == 0)
+              wake_all();
+            if (!steal(w) && !wait_for_work())
+              return;
+            continue;
+          }
+          for (auto i = r.b; i < r.e && !_stop; ++i) {
+            NodePtr p = r.parent ? &(*r.parent)[int(i)] : _root;
+            try {
+              if (!visit(w, *p)) {
+                stop();
+                return;
+              }
+            } catch (...) {
+              if (!_stop.exchange(true)) _error = std::current_exception();
+              wake_all();
+              return;
             }
+            if (auto k = p->size()) {
+              _pending += k;
+              own.push({p, 0, k});
+              wake_one();
+            }
+            done++;
           }
+        }
+      }
 
-          return (*this);
+      bool steal(unsigned w) {
+        run_t r;
+        for (unsigned k = 1; k < size(); ++k) {
+          if (_deques[(w + k) % size()].steal(r)) {
+            _deques[w].push(r);
+            wake_one(); // there might be more to share now
+            return true;
+          }
         }
+        return false;
+      }
 
-        pointer _ptr{};
-        bool _on_children{};
-        size_type _child_idx{};
-      };
-    }; // struct generic_node_t
+      // sleeps until there is something to steal, returns false once the run is over
+      bool wait_for_work() {
+        std::unique_lock<std::mutex> l{_m};
+        _idle++;
+        std::atomic_thread_fence(std::memory_order_seq_cst); // pairs with the one in wake_one()
+        _cv.wait(l, [this] { return _stop || _pending == 0 || has_work(); });
+        _idle--;
+        return !_stop && _pending != 0;
+      }
+      bool has_work() const {
+        for (auto const &d : _deques)
+          if (d.n != 0) return true;
+        return false;
+      }
+      void wake_one() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (_idle.load(std::memory_order_relaxed)) {
+          { std::lock_guard<std::mutex> l{_m}; }
+          _cv.notify_one();
+        }
+      }
+      void wake_all() {
+        { std::lock_guard<std::mutex> l{_m}; }
+        _cv.notify_all();
+      }
+      void stop() {
+        _stop = true;
+        wake_all();
+      }
+
+      std::vector<deque_t> _deques;
+      NodePtr _root{};
+      std::atomic<std::size_t> _pending{};
+      std::atomic<int> _idle{};
+      std::atomic<bool> _stop{};
+      std::exception_ptr _error{};
+      std::mutex _m{};
+      std::condition_variable _cv{};
+    };
 
   } // namespace detail
 
@@ -974,7 +3089,8 @@ namespace dp::tree {
     ~tree_t() { clear(); }
 
     void clear() override {
-      if (_root) delete _root;
+      delete _root;
+      _root = nullptr;
       BaseT::clear();
     }
 
@@ -1004,14 +3120,14 @@ namespace dp::tree {
     Node const &root() const { return *_root; }
     Node &root() { return *_root; }
 
-    iterator begin() { return _root->begin(); }
-    iterator end() { return _root->end(); }
-    const_iterator begin() const { return _root->begin(); }
-    const_iterator end() const { return _root->end(); }
-    reverse_iterator rbegin() { return _root->rbegin(); }
-    reverse_iterator rend() { return _root->rend(); }
-    const_reverse_iterator rbegin() const { return _root->rbegin(); }
-    const_reverse_iterator rend() const { return _root->rend(); }
+    iterator begin() { return iterator::begin(_root); }
+    iterator end() { return iterator::end(_root); }
+    const_iterator begin() const { return const_iterator::begin(_root); }
+    const_iterator end() const { return const_iterator::end(_root); }
+    reverse_iterator rbegin() { return reverse_iterator::begin(_root); }
+    reverse_iterator rend() { return reverse_iterator::end(_root); }
+    const_reverse_iterator rbegin() const { return const_reverse_iterator::begin(_root); }
+    const_reverse_iterator rend() const { return const_reverse_iterator::end(_root); }
 
     // const_iterator find(const_reference v) const {
     //     auto const it = begin(), end_ = end();
@@ -1028,10 +3144,331 @@ namespace dp::tree {
       return it;
     }
 
+    /**
+     * @brief parallel_for_each calls \a fn on every node, on up to \a threads
+     * threads (0 for one per core) and in no particular order. \a fn must be
+     * safe to call concurrently on distinct nodes, and must not add or remove
+     * nodes.
+     */
+    template<typename Fn>
+    void parallel_for_each(Fn &&fn, unsigned threads = 0) {
+      detail::work_stealing_pool<Node>{threads}.run(_root, [&fn](unsigned, reference n) {
+        fn(n);
+        return true;
+      });
+    }
+    template<typename Fn>
+    void parallel_for_each(Fn &&fn, unsigned threads = 0) const {
+      detail::work_stealing_pool<Node const>{threads}.run(_root, [&fn](unsigned, const_reference n) {
+        fn(n);
+        return true;
+      });
+    }
+
+    /**
+     * @brief parallel_find is find() on up to \a threads threads. It stops all of
+     * them as soon as one meets a match. With several matches, which one it
+     * returns is unspecified.
+     */
+    template<typename Pred>
+    const_iterator parallel_find(Pred &&pred_, unsigned threads = 0) const {
+      std::atomic<const_pointer> found{nullptr};
+      detail::work_stealing_pool<Node const>{threads}.run(_root, [&pred_, &found](unsigned, const_reference n) {
+        if (!pred_(n)) return true;
+        const_pointer none{nullptr};
+        found.compare_exchange_strong(none, &n);
+        return false;
+      });
+      auto *p = found.load();
+      return p ? const_iterator{const_cast<pointer>(p), _root} : end();
+    }
+
+    /**
+     * @brief transform_reduce folds transform_(node) over every node with \a
+     * reduce_, starting from \a init, on up to \a threads threads. Like
+     * std::transform_reduce, it needs \a reduce_ to be associative and
+     * commutative.
+     */
+    template<typename T, typename Reduce, typename Transform>
+    T transform_reduce(T init, Reduce &&reduce_, Transform &&transform_, unsigned threads = 0) const {
+      detail::work_stealing_pool<Node const> pool{threads};
+      // one slot per worker, padded apart
+      struct alignas(64) partial_t {
+        std::optional<T> v;
+      };
+      std::vector<partial_t> partials(pool.size());
+      pool.run(_root, [&](unsigned w, const_reference n) {
+        auto &v = partials[w].v;
+        v = v ? reduce_(std::move(*v), transform_(n)) : T(transform_(n));
+        return true;
+      });
+      for (auto &p : partials)
+        if (p.v) init = reduce_(std::move(init), std::move(*p.v));
+      return init;
+    }
+
   private:
     NodePtr _root{nullptr};
   }; // class tree_t
 
+  /**
+   * @brief flat_tree_t is a generic tree like tree_t that keeps all of its nodes
+   * in one contiguous array and links them by index (parent, first/last child,
+   * next/previous sibling) instead of by pointer.
+   *
+   * A tree of N nodes costs amortized O(1) allocations instead of 2N, copying it
+   * is a single array copy (a memcpy when Data is trivially copyable) and
+   * destroying it a single free. As long as the nodes are laid out in preorder,
+   * which holds while children are appended below the most recently added
+   * branch and again after compact(), walking the tree is a linear scan of the
+   * array.
+   *
+   * Indices stay valid across inserts; references to nodes do not, as with
+   * std::vector.
+   */
+  template<typename Data, typename Alloc = std::allocator<Data>>
+  class flat_tree_t {
+  public:
+    using index_type = std::uint32_t;
+    static constexpr index_type npos = index_type(-1);
+
+    class node_t {
+    public:
+      template<typename... Args>
+      explicit node_t(index_type parent_, Args &&...args)
+          : _data{std::forward<Args>(args)...}
+          , _parent{parent_} {}
+
+      Data &data() { return _data; }
+      Data const &data() const { return _data; }
+      Data &operator*() { return _data; }
+      Data const &operator*() const { return _data; }
+      Data *operator->() { return &_data; }
+      Data const *operator->() const { return &_data; }
+      index_type parent() const { return _parent; }
+      index_type first_child() const { return _first; }
+      index_type last_child() const { return _last; }
+      index_type next_sibling() const { return _next; }
+      index_type prev_sibling() const { return _prev; }
+      bool has_children() const { return _count != 0; }
+      bool empty() const { return _count == 0; }
+      size_type size() const { return _count; }
+
+    private:
+      friend class flat_tree_t;
+      Data _data;
+      index_type _parent{npos}, _first{npos}, _last{npos}, _next{npos}, _prev{npos};
+      index_type _count{};
+    };
+
+    using Self = flat_tree_t<Data, Alloc>;
+    using NodeT = node_t;
+    using allocator_type = typename std::allocator_traits<Alloc>::template rebind_alloc<node_t>;
+    using Nodes = std::vector<node_t, allocator_type>;
+
+    /**
+     * @brief preorder_iterator walks the tree parent first, children followed,
+     * stepping to the next array slot while the nodes are laid out in preorder
+     * and following the sibling links otherwise.
+     */
+    template<bool Const>
+    class preorder_iterator {
+    public:
+      using difference_type = std::ptrdiff_t;
+      using value_type = node_t;
+      using pointer = std::conditional_t<Const, node_t const *, node_t *>;
+      using reference = std::conditional_t<Const, node_t const &, node_t &>;
+      using const_pointer = node_t const *;
+      using const_reference = node_t const &;
+      using iterator_category = std::bidirectional_iterator_tag;
+      using self = preorder_iterator;
+      using tree_pointer = std::conditional_t<Const, flat_tree_t const *, flat_tree_t *>;
+
+      preorder_iterator() = default;
+      preorder_iterator(tree_pointer t_, index_type i_)
+          : _t(t_), _i(i_) {}
+      operator preorder_iterator<true>() const { return {_t, _i}; }
+
+      index_type index() const { return _i; }
+      bool operator==(self const &r) const { return _i == r._i && _t == r._t; }
+      bool operator!=(self const &r) const { return !(*this == r); }
+      reference operator*() const { return _t->_nodes[_i]; }
+      pointer operator->() const { return &_t->_nodes[_i]; }
+      self &operator++() {
+        _i = _t->next_preorder(_i);
+        return *this;
+      }
+      self operator++(int) {
+        self copy{*this};
+        ++(*this);
+        return copy;
+      }
+      self &operator--() {
+        _i = _t->prev_preorder(_i);
+        return *this;
+      }
+      self operator--(int) {
+        self copy{*this};
+        --(*this);
+        return copy;
+      }
+
+    private:
+      tree_pointer _t{};
+      index_type _i{npos};
+    };
+
+    using iterator = preorder_iterator<false>;
+    using const_iterator = preorder_iterator<true>;
+    using reverse_iterator = std::reverse_iterator<iterator>;
+    using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+    using difference_type = std::ptrdiff_t;
+    using value_type = node_t;
+    using pointer = node_t *;
+    using reference = node_t &;
+    using const_pointer = node_t const *;
+    using const_reference = node_t const &;
+
+  public:
+    flat_tree_t() = default;
+    explicit flat_tree_t(Alloc const &alloc_)
+        : _nodes(allocator_type(alloc_)) {}
+
+    void clear() {
+      _nodes.clear();
+      _preorder = true;
+    }
+    void reserve(size_type n) { _nodes.reserve(n); }
+    size_type capacity() const { return _nodes.capacity(); }
+    size_type count() const { return _nodes.size(); }
+    size_type size() const { return _nodes.size(); }
+    bool empty() const { return _nodes.empty(); }
+    /**
+     * @brief is_preorder tells whether the array is in preorder, so that
+     * iterating is a linear scan.
+     */
+    bool is_preorder() const { return _preorder; }
+
+    // inserts the root, or a child of the root once there is one, like tree_t
+    index_type insert(Data const &data) { return emplace_child(_nodes.empty() ? npos : 0, data); }
+    index_type insert(Data &&data) { return emplace_child(_nodes.empty() ? npos : 0, std::move(data)); }
+    template<typename... Args>
+    index_type emplace(Args &&...args) { return emplace_child(_nodes.empty() ? npos : 0, std::forward<Args>(args)...); }
+
+    index_type insert_child(index_type parent_, Data const &data) { return emplace_child(parent_, data); }
+    index_type insert_child(index_type parent_, Data &&data) { return emplace_child(parent_, std::move(data)); }
+    /**
+     * @brief emplace_child appends a new last child to \a parent_, or makes the
+     * root of an empty tree when \a parent_ is npos.
+     * @return the index of the new node
+     */
+    template<typename... Args>
+    index_type emplace_child(index_type parent_, Args &&...args) {
+      assert(parent_ == npos ? _nodes.empty() : parent_ < _nodes.size());
+      // still in preorder only if the subtree of parent_ is the tail of the
+      // array, that is, neither parent_ nor its ancestors have a next sibling
+      for (auto q = parent_; _preorder && q != npos; q = _nodes[q]._parent)
+        _preorder = _nodes[q]._next == npos;
+
+      auto i = index_type(_nodes.size());
+      _nodes.emplace_back(parent_, std::forward<Args>(args)...);
+      if (parent_ != npos) {
+        auto &p = _nodes[parent_];
+        if (p._last != npos) {
+          _nodes[p._last]._next = i;
+          _nodes[i]._prev = p._last;
+        } else
+          p._first = i;
+        p._last = i;
+        p._count++;
+      }
+      return i;
+    }
+
+    /**
+     * @brief compact re-lays the nodes out in preorder, so that iterating
+     * becomes a linear scan again. Indices taken before are invalidated.
+     */
+    void compact() {
+      if (_preorder) return;
+      std::vector<index_type> order, remap(_nodes.size());
+      order.reserve(_nodes.size());
+      for (index_type i = 0; i != npos; i = next_preorder(i)) {
+        remap[i] = index_type(order.size());
+        order.push_back(i);
+      }
+      auto to = [&remap](index_type i) { return i == npos ? npos : remap[i]; };
+      Nodes out(_nodes.get_allocator());
+      out.reserve(_nodes.capacity());
+      for (auto i : order) {
+        auto &n = out.emplace_back(std::move(_nodes[i]));
+        n._parent = to(n._parent), n._first = to(n._first), n._last = to(n._last);
+        n._next = to(n._next), n._prev = to(n._prev);
+      }
+      _nodes.swap(out);
+      _preorder = true;
+    }
+
+    node_t const &root() const { return _nodes.front(); }
+    node_t &root() { return _nodes.front(); }
+    node_t const &operator[](index_type i) const { return _nodes[i]; }
+    node_t &operator[](index_type i) { return _nodes[i]; }
+    index_type index_of(node_t const &n) const { return index_type(&n - _nodes.data()); }
+
+    iterator begin() { return {this, _nodes.empty() ? npos : 0}; }
+    iterator end() { return {this, npos}; }
+    const_iterator begin() const { return {this, _nodes.empty() ? npos : 0}; }
+    const_iterator end() const { return {this, npos}; }
+    reverse_iterator rbegin() { return reverse_iterator{end()}; }
+    reverse_iterator rend() { return reverse_iterator{begin()}; }
+    const_reverse_iterator rbegin() const { return const_reverse_iterator{end()}; }
+    const_reverse_iterator rend() const { return const_reverse_iterator{begin()}; }
+
+    /**
+     * @brief subtree returns the nodes below \a i, \a i included, in preorder.
+     */
+    detail::node_range<iterator> subtree(index_type i) { return {{this, i}, {this, skip(i)}}; }
+    detail::node_range<const_iterator> subtree(index_type i) const { return {{this, i}, {this, skip(i)}}; }
+
+    const_iterator find(std::function<bool(const_reference)> &&pred_) const {
+      auto it = begin(), end_ = end();
+      for (; it != end_; ++it)
+        if (pred_(*it))
+          break;
+      return it;
+    }
+
+  private:
+    index_type next_preorder(index_type i) const {
+      if (_preorder)
+        return i + 1 < _nodes.size() ? i + 1 : npos;
+      if (_nodes[i]._first != npos)
+        return _nodes[i]._first;
+      return skip(i);
+    }
+    // the node following the subtree of i in preorder: the next sibling of the
+    // nearest ancestor-or-self having one
+    index_type skip(index_type i) const {
+      for (; i != npos; i = _nodes[i]._parent)
+        if (_nodes[i]._next != npos) return _nodes[i]._next;
+      return npos;
+    }
+    index_type prev_preorder(index_type i) const {
+      if (_preorder)
+        return i == npos ? index_type(_nodes.size() - 1) : i - 1;
+      if (i != npos && _nodes[i]._prev == npos)
+        return _nodes[i]._parent;
+      i = i == npos ? 0 : _nodes[i]._prev;
+      while (_nodes[i]._last != npos) i = _nodes[i]._last;
+      return i;
+    }
+
+  private:
+    Nodes _nodes{};
+    bool _preorder{true};
+  }; // class flat_tree_t
+
 } // namespace dp::tree
 
 
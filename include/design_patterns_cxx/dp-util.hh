@@ -23,12 +23,20 @@
 #include "dp-log.hh"
 #include "dp-string.hh"
 
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <new>
 #include <string>
 #include <string_view>
 #include <tuple>
+#include <vector>
 
+#include <atomic>
 #include <functional>
 #include <memory>
+#include <mutex>
 #include <type_traits>
 #include <utility>
 
@@ -95,6 +103,173 @@ namespace dp {
 #define __FACTORY_T_DEFINED
 namespace dp::util::factory {
 
+  namespace detail {
+    // 32-bit FNV-1a with a seed, so that perfect_hash can try several
+    constexpr std::uint32_t fnv1a(id_type s, std::uint32_t seed) {
+      std::uint32_t h = 2166136261u ^ seed;
+      for (char c : s) h = (h ^ std::uint8_t(c)) * 16777619u;
+      return h ^ (h >> 16);
+    }
+
+    /**
+     * @brief perfect_hash looks, at compile time, for the smallest power-of-two
+     * table and a seed under which the N ids land in distinct slots.
+     */
+    template<std::size_t N>
+    struct perfect_hash {
+      static constexpr std::size_t max_slots = [] {
+        std::size_t n = 1;
+        while (n < 4 * N) n *= 2;
+        return n;
+      }();
+
+      std::size_t mask{};
+      std::uint32_t seed{};
+      bool ok{};
+
+      constexpr explicit perfect_hash(std::array<id_type, N> const &ids) {
+        for (std::size_t size = 1; size <= max_slots && !ok; size *= 2) {
+          if (size < N) continue;
+          for (std::uint32_t s = 0; s < 1024 && !ok; s++) {
+            std::array<bool, max_slots> used{};
+            ok = true;
+            for (std::size_t i = 0; i < N && ok; i++) {
+              auto &u = used[fnv1a(ids[i], s) & (size - 1)];
+              ok = !u;
+              u = true;
+            }
+            mask = size - 1, seed = s;
+          }
+        }
+      }
+
+      constexpr std::size_t slot(id_type id) const { return fnv1a(id, seed) & mask; }
+      constexpr std::size_t slots() const { return mask + 1; }
+    };
+
+    /**
+     * @brief object_pool keeps the freed blocks of one type for reuse. The free
+     * list is per thread, so that taking and recycling a block needs no lock;
+     * a block freed on another thread than it was taken from just moves there.
+     */
+    template<typename T>
+    class object_pool {
+      union block_t {
+        block_t *next;
+        alignas(T) unsigned char storage[sizeof(T)];
+      };
+      // beyond it, recycled blocks go back to the heap
+      static constexpr std::size_t max_cached = 1024;
+
+    public:
+      static object_pool &local() {
+        static thread_local object_pool pool;
+        return pool;
+      }
+      ~object_pool() {
+        while (_free) delete std::exchange(_free, _free->next);
+      }
+
+      void *get() {
+        if (!_free) return new block_t;
+        _cached--;
+        return std::exchange(_free, _free->next);
+      }
+      void put(void *p) {
+        auto *b = static_cast<block_t *>(p);
+        if (_cached == max_cached) {
+          delete b;
+          return;
+        }
+        b->next = std::exchange(_free, b);
+        _cached++;
+      }
+      std::size_t cached() const { return _cached; }
+
+    private:
+      object_pool() = default;
+      block_t *_free{};
+      std::size_t _cached{};
+    };
+  } // namespace detail
+
+  /**
+   * @brief monotonic_arena hands out memory by bumping a pointer through
+   * blocks of growing size, and never frees a single object. release(), or
+   * the destructor, destroys the objects made by make() in reverse order and
+   * takes all the memory back at once, keeping the biggest block for the
+   * next round. Meant for request-scoped objects, on one thread.
+   */
+  class monotonic_arena {
+  public:
+    CLAZZ_NON_COPYABLE(monotonic_arena);
+    explicit monotonic_arena(std::size_t initial_bytes = 4096)
+        : _next_size(initial_bytes) {}
+    ~monotonic_arena() {
+      release();
+      if (_blocks) ::operator delete(_blocks);
+    }
+
+    template<typename T, typename... Args>
+    T *make(Args &&...args) {
+      if constexpr (std::is_trivially_destructible_v<T>) {
+        return ::new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+      } else {
+        auto *d = static_cast<dtor_t *>(allocate(sizeof(dtor_t), alignof(dtor_t)));
+        T *p = ::new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+        *d = dtor_t{[](void *o) { static_cast<T *>(o)->~T(); }, p, _dtors};
+        _dtors = d;
+        return p;
+      }
+    }
+
+    void *allocate(std::size_t bytes, std::size_t align = alignof(std::max_align_t)) {
+      auto p = (_cur + align - 1) & ~(align - 1);
+      if (!_blocks || p + bytes > _end) {
+        grow(bytes + align);
+        p = (_cur + align - 1) & ~(align - 1);
+      }
+      _cur = p + bytes;
+      return reinterpret_cast<void *>(p);
+    }
+
+    void release() {
+      for (; _dtors; _dtors = _dtors->prev) _dtors->destroy(_dtors->obj);
+      if (!_blocks) return;
+      // the blocks only grow, so the newest one is the biggest: keep it and free the older ones
+      while (_blocks->prev) ::operator delete(std::exchange(_blocks->prev, _blocks->prev->prev));
+      _next_size = _blocks->size * 2;
+      reset_to(_blocks);
+    }
+
+  private:
+    struct block_t {
+      block_t *prev;
+      std::size_t size;
+    };
+    struct dtor_t {
+      void (*destroy)(void *);
+      void *obj;
+      dtor_t *prev;
+    };
+
+    void grow(std::size_t min_bytes) {
+      auto size = std::max(_next_size, min_bytes + sizeof(block_t));
+      _blocks = ::new (::operator new(size)) block_t{_blocks, size};
+      _next_size = size * 2;
+      reset_to(_blocks);
+    }
+    void reset_to(block_t *b) {
+      _cur = reinterpret_cast<std::uintptr_t>(b + 1);
+      _end = reinterpret_cast<std::uintptr_t>(b) + b->size;
+    }
+
+    block_t *_blocks{};
+    dtor_t *_dtors{};
+    std::uintptr_t _cur{}, _end{};
+    std::size_t _next_size;
+  };
+
   /**
        * @brief a factory template class
        * @tparam product_base   such as `Shape`
@@ -128,27 +303,146 @@ namespace dp::util::factory {
                  named_products{});
     }
 
+    /**
+     * @brief recycler is the deleter of pooled products: it destroys the
+     * product and gives its memory back to the pool of its type.
+     */
+    struct recycler {
+      void (*recycle)(product_base *){};
+      void operator()(product_base *p) const { recycle(p); }
+    };
+    using pooled_ptr = std::unique_ptr<product_base, recycler>;
+
+    /**
+     * @brief create makes the product named \a id with \a args, or returns
+     * nullptr if there is none or it is not constructible from \a args.
+     * @details the ids are perfectly hashed at compile time into a table of
+     * creators, so that a lookup is one hash, one compare and one indirect call.
+     */
     template<typename... Args>
-    static auto create(string const &id, Args &&...args) {
-      std::unique_ptr<product_base> result{};
-      std::apply([&](auto &&...it) {
-        ((it.id == id ? result = it.gen(args...) : result), ...);
-      },
-                 named_products{});
-      return result;
+    static std::unique_ptr<product_base> create(string const &id, Args &&...args) {
+      return dispatch<by_new>(nullptr, id, std::forward<Args>(args)...);
     }
+    /**
+     * @brief make_shared is create() into a shared_ptr, with the product and
+     * the control block in a single allocation.
+     */
     template<typename... Args>
     static std::shared_ptr<product_base> make_shared(string const &id, Args &&...args) {
-      std::shared_ptr<product_base> ptr = create(id, args...);
-      return ptr;
+      return allocate_shared(std::allocator<product_base>{}, id, std::forward<Args>(args)...);
+    }
+    template<typename Alloc, typename... Args>
+    static std::shared_ptr<product_base> allocate_shared(Alloc const &alloc, string const &id, Args &&...args) {
+      return dispatch<by_allocate_shared<Alloc>>(&alloc, id, std::forward<Args>(args)...);
     }
     template<typename... Args>
     static std::unique_ptr<product_base> make_unique(string const &id, Args &&...args) {
-      return create(id, args...);
+      return create(id, std::forward<Args>(args)...);
     }
     template<typename... Args>
     static product_base *create_nacked_ptr(string const &id, Args &&...args) {
-      return create(id, args...).release();
+      return create(id, std::forward<Args>(args)...).release();
+    }
+    /**
+     * @brief create_pooled makes the product in memory taken from the
+     * per-thread pool of its type, where the returned pointer gives it back.
+     * Pooled products must not outlive the threads' pools, that is, must not
+     * be held in static storage.
+     */
+    template<typename... Args>
+    static pooled_ptr create_pooled(string const &id, Args &&...args) {
+      return dispatch<by_pool>(nullptr, id, std::forward<Args>(args)...);
+    }
+    /**
+     * @brief create_in makes the product in \a arena, which owns it: it is
+     * destroyed by arena.release() and must not be deleted.
+     */
+    template<typename... Args>
+    static product_base *create_in(monotonic_arena &arena, string const &id, Args &&...args) {
+      return dispatch<by_arena>(&arena, id, std::forward<Args>(args)...);
+    }
+
+  private:
+    static constexpr std::array<string, sizeof...(products)> _ids{id_name<products>()...};
+    static constexpr detail::perfect_hash<sizeof...(products)> _hash{_ids};
+    static_assert(_hash.ok, "the product ids must be distinct");
+
+    // the creation policies: where the product lives and what owns it
+    struct by_new {
+      using context = std::nullptr_t;
+      using result = std::unique_ptr<product_base>;
+      template<typename T, typename... Args>
+      static result make(context, Args &&...args) { return std::make_unique<T>(std::forward<Args>(args)...); }
+    };
+    template<typename Alloc>
+    struct by_allocate_shared {
+      using context = Alloc const *;
+      using result = std::shared_ptr<product_base>;
+      template<typename T, typename... Args>
+      static result make(context alloc, Args &&...args) {
+        using alloc_t = typename std::allocator_traits<Alloc>::template rebind_alloc<T>;
+        return std::allocate_shared<T>(alloc_t(*alloc), std::forward<Args>(args)...);
+      }
+    };
+    struct by_pool {
+      using context = std::nullptr_t;
+      using result = pooled_ptr;
+      template<typename T, typename... Args>
+      static result make(context, Args &&...args) {
+        auto &pool = detail::object_pool<T>::local();
+        void *mem = pool.get();
+        try {
+          return result{::new (mem) T(std::forward<Args>(args)...), recycler{&recycle<T>}};
+        } catch (...) {
+          pool.put(mem);
+          throw;
+        }
+      }
+      template<typename T>
+      static void recycle(product_base *p) {
+        T *t = static_cast<T *>(p);
+        t->~T();
+        detail::object_pool<T>::local().put(t);
+      }
+    };
+    struct by_arena {
+      using context = monotonic_arena *;
+      using result = product_base *;
+      template<typename T, typename... Args>
+      static result make(context arena, Args &&...args) { return arena->template make<T>(std::forward<Args>(args)...); }
+    };
+
+    // the jump table of creators for a creation policy and a list of argument types
+    template<typename Policy, typename... Args>
+    struct creators {
+      using context = typename Policy::context;
+      using result = typename Policy::result;
+      using creator = result (*)(context, Args &&...);
+      struct slot_t {
+        string id{};
+        creator fn{};
+      };
+      template<typename T>
+      static result gen(context c, Args &&...args) {
+        if constexpr (std::is_constructible_v<T, Args &&...>)
+          return Policy::template make<T>(c, std::forward<Args>(args)...);
+        else
+          return result{};
+      }
+      static constexpr auto make_table() {
+        std::array<slot_t, _hash.slots()> t{};
+        ((t[_hash.slot(id_name<products>())] = slot_t{id_name<products>(), &gen<products>}), ...);
+        return t;
+      }
+      static constexpr auto table = make_table();
+    };
+
+    template<typename Policy, typename... Args>
+    static typename Policy::result dispatch(typename Policy::context c, string const &id, Args &&...args) {
+      auto const &slot = creators<Policy, Args...>::table[_hash.slot(id)];
+      if (slot.fn && slot.id == id)
+        return slot.fn(c, std::forward<Args>(args)...);
+      return typename Policy::result{};
     }
 
   private:
@@ -158,6 +452,206 @@ namespace dp::util::factory {
     // }
   }; // class factory
 
+  /**
+   * @brief registry is the runtime counterpart of factory: products are
+   * registered by id while the program runs, from plugins for instance, and
+   * made through the same create/make_unique/make_shared calls.
+   *
+   * Lookups take no lock. The ids live in an open-addressing table whose
+   * slots are published with release stores; a writer, serialized by a
+   * mutex, fills a slot or publishes a grown copy of the table. Superseded
+   * tables, entries and creators are kept until the registry dies, so a
+   * reader never meets freed memory. intern() returns a handle to the entry
+   * of an id, which skips the hashing altogether.
+   *
+   * @tparam product_base   such as `Shape`
+   * @tparam Args           the constructor arguments every product takes
+   */
+  template<typename product_base, typename... Args>
+  class registry final {
+    struct entry;
+
+  public:
+    CLAZZ_NON_COPYABLE(registry);
+    using string = id_type;
+    using unique_creator = std::unique_ptr<product_base> (*)(Args...);
+    using shared_creator = std::shared_ptr<product_base> (*)(Args...);
+
+    /**
+     * @brief interned_id names a registered id for the lifetime of the registry.
+     */
+    class interned_id {
+    public:
+      interned_id() = default;
+      explicit operator bool() const { return _e != nullptr; }
+      string name() const { return _e ? string{_e->name} : string{}; }
+      bool operator==(interned_id const &o) const { return _e == o._e; }
+      bool operator!=(interned_id const &o) const { return _e != o._e; }
+
+    private:
+      friend class registry;
+      explicit interned_id(entry const *e)
+          : _e(e) {}
+      entry const *_e{};
+    };
+
+    registry() { publish(16); }
+    ~registry() = default;
+
+    /**
+     * @brief add registers T under \a id, replacing the creators of an id that
+     * is registered already.
+     * @return false if \a id was registered already
+     */
+    template<typename T>
+    bool add(string id = id_name<T>()) {
+      static_assert(std::is_base_of<product_base, T>::value, "all products must inherit from product_base");
+      return add(
+          id, [](Args... args) -> std::unique_ptr<product_base> { return std::make_unique<T>(std::move(args)...); },
+          [](Args... args) -> std::shared_ptr<product_base> { return std::make_shared<T>(std::move(args)...); });
+    }
+    /**
+     * @brief add registers the creators for \a id. Without \a make_shared_,
+     * make_shared() converts what \a create_ returns.
+     */
+    bool add(string id, unique_creator create_, shared_creator make_shared_ = nullptr) {
+      std::lock_guard<std::mutex> l{_m};
+      auto *e = const_cast<entry *>(intern_locked(id));
+      auto *fns = _creators.emplace_back(std::make_unique<creators>(creators{create_, make_shared_})).get();
+      return e->fns.exchange(fns, std::memory_order_acq_rel) == nullptr;
+    }
+    /**
+     * @brief remove unregisters \a id; its interned ids stay valid, and create
+     * returns nullptr for them until it is added again.
+     */
+    bool remove(string id) {
+      std::lock_guard<std::mutex> l{_m};
+      auto *e = const_cast<entry *>(lookup(id));
+      return e && e->fns.exchange(nullptr, std::memory_order_acq_rel) != nullptr;
+    }
+
+    interned_id intern(string id) {
+      std::lock_guard<std::mutex> l{_m};
+      return interned_id{intern_locked(id)};
+    }
+    // the interned id of \a id, empty if it was never added nor interned
+    interned_id find(string id) const { return interned_id{lookup(id)}; }
+    bool contains(string id) const { return get(lookup(id)) != nullptr; }
+
+    template<typename Id>
+    std::unique_ptr<product_base> create(Id const &id, Args... args) const {
+      auto *e = resolve(id);
+      auto *fns = get(e);
+      if (!fns) return nullptr;
+      e->created.fetch_add(1, std::memory_order_relaxed);
+      return fns->unique(std::move(args)...);
+    }
+    template<typename Id>
+    std::unique_ptr<product_base> make_unique(Id const &id, Args... args) const {
+      return create(id, std::move(args)...);
+    }
+    template<typename Id>
+    std::shared_ptr<product_base> make_shared(Id const &id, Args... args) const {
+      auto *e = resolve(id);
+      auto *fns = get(e);
+      if (!fns) return nullptr;
+      e->created.fetch_add(1, std::memory_order_relaxed);
+      if (fns->shared) return fns->shared(std::move(args)...);
+      return fns->unique(std::move(args)...);
+    }
+    /**
+     * @brief create_n makes \a n products of \a id, each from a copy of \a
+     * args, looking the id up once.
+     */
+    template<typename Id>
+    std::vector<std::unique_ptr<product_base>> create_n(Id const &id, std::size_t n, Args const &...args) const {
+      std::vector<std::unique_ptr<product_base>> out;
+      auto *e = resolve(id);
+      auto *fns = get(e);
+      if (!fns) return out;
+      out.reserve(n);
+      for (std::size_t i = 0; i < n; i++) out.push_back(fns->unique(args...));
+      e->created.fetch_add(n, std::memory_order_relaxed);
+      return out;
+    }
+
+    // how many products of \a id were made so far
+    template<typename Id>
+    std::uint64_t created(Id const &id) const {
+      auto *e = resolve(id);
+      return e ? e->created.load(std::memory_order_relaxed) : 0;
+    }
+    // how many ids are registered
+    std::size_t size() const {
+      std::lock_guard<std::mutex> l{_m};
+      return std::size_t(std::count_if(_entries.begin(), _entries.end(), [](auto const &e) { return get(e.get()) != nullptr; }));
+    }
+
+  private:
+    struct creators {
+      unique_creator unique;
+      shared_creator shared;
+    };
+    struct alignas(64) entry {
+      explicit entry(string id)
+          : name(id) {}
+      std::string name;
+      std::atomic<creators const *> fns{};
+      mutable std::atomic<std::uint64_t> created{};
+    };
+    struct table_t {
+      explicit table_t(std::size_t size)
+          : mask(size - 1)
+          , slots(new std::atomic<entry const *>[size]) {
+        for (std::size_t i = 0; i < size; i++) slots[i].store(nullptr, std::memory_order_relaxed);
+      }
+      std::size_t mask;
+      std::unique_ptr<std::atomic<entry const *>[]> slots;
+    };
+
+    static creators const *get(entry const *e) { return e ? e->fns.load(std::memory_order_acquire) : nullptr; }
+    entry const *resolve(interned_id const &id) const { return id._e; }
+    entry const *resolve(string id) const { return lookup(id); }
+    entry const *resolve(char const *id) const { return lookup(id); }
+    entry const *resolve(std::string const &id) const { return lookup(id); }
+
+    entry const *lookup(string id) const {
+      auto const *t = _table.load(std::memory_order_acquire);
+      for (auto i = detail::fnv1a(id, 0) & t->mask;; i = (i + 1) & t->mask) {
+        auto const *e = t->slots[i].load(std::memory_order_acquire);
+        if (!e || e->name == id) return e;
+      }
+    }
+
+    entry const *intern_locked(string id) {
+      if (auto const *e = lookup(id)) return e;
+      auto const *e = _entries.emplace_back(std::make_unique<entry>(id)).get();
+      auto const *t = _table.load(std::memory_order_relaxed);
+      if (2 * _entries.size() > t->mask + 1)
+        publish(2 * (t->mask + 1)); // the grown table holds e already
+      else
+        place(*t, e);
+      return e;
+    }
+    // makes a table of \a size slots holding every entry the current one
+    void publish(std::size_t size) {
+      auto *t = _tables.emplace_back(std::make_unique<table_t>(size)).get();
+      for (auto const &e : _entries) place(*t, e.get());
+      _table.store(t, std::memory_order_release);
+    }
+    static void place(table_t const &t, entry const *e) {
+      auto i = detail::fnv1a(e->name, 0) & t.mask;
+      while (t.slots[i].load(std::memory_order_relaxed)) i = (i + 1) & t.mask;
+      t.slots[i].store(e, std::memory_order_release);
+    }
+
+    mutable std::mutex _m;
+    std::atomic<table_t const *> _table{};
+    std::vector<std::unique_ptr<table_t>> _tables;
+    std::vector<std::unique_ptr<entry>> _entries;
+    std::vector<std::unique_ptr<creators>> _creators;
+  }; // class registry
+
 } // namespace dp::util::factory
 #endif //__FACTORY_T_DEFINED
 
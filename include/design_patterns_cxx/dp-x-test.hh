@@ -8,8 +8,10 @@
 #if defined(DP_CXX_UNIT_TEST) && DP_CXX_UNIT_TEST == 1
 
 #include <algorithm>
+#include <cstdlib>
 #include <ctime>
 #include <functional>
+#include <iostream>
 #include <memory>
 
 #include "dp-chrono.hh"
@@ -77,6 +79,21 @@ namespace dp::test {
      */
 #define DP_TEST_FOR(f) dp::test::bind(#f, f)
 
+    inline void check(bool ok, const char *expr, const char *msg, const char *file, int line) {
+        if (!ok) {
+            std::cerr << "Check failed : " << msg << "\n"
+                      << "    Expected : " << expr << "\n"
+                      << "      Source : " << file << ':' << line << "\n";
+            std::abort();
+        }
+    }
+
+    /**
+     * @brief DP_TEST_CHECK is assertm() for the test apps: it aborts on a
+     * failure in every build type, not only with _DEBUG.
+     */
+#define DP_TEST_CHECK(expr, msg) dp::test::check(bool(expr), #expr, msg, __FILE__, __LINE__)
+
     namespace detail {
         inline void third_party(int n, std::function<void(int)> f) {
             f(n);
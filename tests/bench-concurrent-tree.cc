@@ -0,0 +1,175 @@
+// design_patterns_cxx Library
+// Copyright © 2021 Hedzr Yeh.
+//
+// This file is released under the terms of the MIT license.
+// Read /LICENSE for more information.
+
+//
+// Created by Hedzr Yeh on 2021/10/20.
+//
+
+#include "design_patterns_cxx/dp-tree.hh"
+
+#include "design_patterns_cxx/dp-x-test.hh"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <mutex>
+#include <random>
+#include <set>
+#include <shared_mutex>
+#include <thread>
+#include <vector>
+
+namespace dp::bench::concurrent_tree {
+
+  // std::set behind a mutex, the usual way
+  template<typename Mutex>
+  struct locked_set {
+    std::set<int> s;
+    mutable Mutex m;
+    bool insert(int k) {
+      std::unique_lock<Mutex> l{m};
+      return s.insert(k).second;
+    }
+    bool erase(int k) {
+      std::unique_lock<Mutex> l{m};
+      return s.erase(k) == 1;
+    }
+    bool contains(int k) const {
+      if constexpr (std::is_same_v<Mutex, std::shared_mutex>) {
+        std::shared_lock<Mutex> l{m};
+        return s.count(k) == 1;
+      } else {
+        std::unique_lock<Mutex> l{m};
+        return s.count(k) == 1;
+      }
+    }
+  };
+
+  // runs \a ops operations on each of \a threads threads, \a writes percent of them
+  // inserts or erases, the others lookups; returns the operations per second
+  template<typename Set>
+  inline double throughput(Set &s, std::size_t threads, int writes, std::size_t ops) {
+    constexpr int keys = 100'000;
+    for (int k = 0; k < keys; k += 2) s.insert(k);
+
+    auto then = std::chrono::high_resolution_clock::now();
+    std::vector<std::thread> ts;
+    for (std::size_t t = 0; t < threads; t++)
+      ts.emplace_back([&s, t, writes, ops] {
+        std::mt19937 rng{unsigned(t)};
+        std::size_t found{};
+        for (std::size_t i = 0; i < ops; i++) {
+          int k = int(rng() % keys);
+          int op = int(rng() % 100);
+          if (op < writes / 2)
+            s.insert(k);
+          else if (op < writes)
+            s.erase(k);
+          else
+            found += s.contains(k);
+        }
+        if (found > ops) std::fprintf(stderr, "  impossible\n");
+      });
+    for (auto &t : ts) t.join();
+    auto elapsed = std::chrono::high_resolution_clock::now() - then;
+    return double(threads * ops) / std::chrono::duration<double>(elapsed).count();
+  }
+
+  template<typename Fn>
+  inline double elapsed_ms(Fn &&fn) {
+    auto then = std::chrono::high_resolution_clock::now();
+    fn();
+    return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - then).count();
+  }
+
+  // visits \a t on \a threads workers, returns the share of the nodes the busiest one visited
+  template<typename Tree>
+  inline double busiest_share(Tree const &t, unsigned threads) {
+    using node = typename Tree::NodeT;
+    dp::tree::detail::work_stealing_pool<node const> pool{threads};
+    struct alignas(64) counter_t {
+      std::size_t n{};
+    };
+    std::vector<counter_t> counts(pool.size());
+    pool.run(&t.root(), [&counts](unsigned w, node const &) {
+      counts[w].n++;
+      return true;
+    });
+    std::size_t total{}, most{};
+    for (auto const &c : counts) total += c.n, most = std::max(most, c.n);
+    return double(most) / double(total);
+  }
+
+  // the sequential walks against the parallel ones on \a threads threads
+  template<typename Tree>
+  inline void parallel_walks(Tree const &t, char const *shape, unsigned threads) {
+    using node = typename Tree::NodeT;
+    auto missing = [](node const &n) { return *n < 0; };
+    auto value = [](node const &n) { return (long long) *n; };
+
+    long long sums[2]{};
+    std::printf("%-32s %12s\n", shape, "ms");
+    std::printf("%-32s %12.2f\n", "find, no match", elapsed_ms([&] { sums[0] += t.find(missing) == t.end(); }));
+    std::printf("%-32s %12.2f\n", "parallel_find, no match", elapsed_ms([&] { sums[1] += t.parallel_find(missing, threads) == t.end(); }));
+    std::printf("%-32s %12.2f\n", "sum over iterators", elapsed_ms([&] {
+                  for (auto const &n : t) sums[0] += value(n);
+                }));
+    std::printf("%-32s %12.2f\n", "transform_reduce", elapsed_ms([&] { sums[1] += t.transform_reduce(0LL, std::plus<>{}, value, threads); }));
+    if (sums[0] != sums[1])
+      std::fprintf(stderr, "  the traversals disagree\n");
+    std::printf("%-32s %11.1f%%\n", "busiest worker's share", 100 * busiest_share(t, threads));
+  }
+
+} // namespace dp::bench::concurrent_tree
+
+void bench_concurrent_tree() {
+  using namespace dp::bench::concurrent_tree;
+  constexpr std::size_t ops = 200'000;
+  std::size_t cores = std::max(2u, std::thread::hardware_concurrency());
+
+  std::printf("%8s %8s %16s %16s %16s\n", "threads", "writes", "skip list", "set+mutex", "set+shared_mutex");
+  for (std::size_t threads = 1; threads <= cores; threads *= 2) {
+    for (int writes : {5, 50}) {
+      dp::tree::concurrent_skip_list<int> a;
+      locked_set<std::mutex> b;
+      locked_set<std::shared_mutex> c;
+      auto ra = throughput(a, threads, writes, ops);
+      auto rb = throughput(b, threads, writes, ops);
+      auto rc = throughput(c, threads, writes, ops);
+      std::printf("%8zu %7d%% %16.0f %16.0f %16.0f\n", threads, writes, ra, rb, rc);
+    }
+  }
+}
+
+void bench_parallel_tree() {
+  using namespace dp::bench::concurrent_tree;
+  unsigned threads = std::max(4u, std::thread::hardware_concurrency());
+  std::printf("%u threads\n", threads);
+
+  // a tree of 2M nodes: a root, 2000 children, 1000 grandchildren each
+  dp::tree::tree_t<int> t;
+  t.insert(0);
+  for (int i = 0; i < 2000; i++) {
+    t.insert(i);
+    for (int j = 0; j < 1000; j++)
+      t.root()[i].emplace(i * 1000 + j);
+  }
+  parallel_walks(t, "2M nodes, 2000 x 1000", threads);
+
+  // a wide one: a root and 2M leaves, all the work hangs off a single node
+  dp::tree::tree_t<int> wide;
+  wide.insert(0);
+  for (int i = 0; i < 2'000'000; i++)
+    wide.insert(i);
+  parallel_walks(wide, "2M nodes, 1 x 2M", threads);
+}
+
+int main() {
+  DP_TEST_FOR(bench_concurrent_tree);
+  DP_TEST_FOR(bench_parallel_tree);
+  return 0;
+}
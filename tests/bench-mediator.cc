@@ -0,0 +1,87 @@
+// design_patterns_cxx Library
+// Copyright © 2021 Hedzr Yeh.
+//
+// This file is released under the terms of the MIT license.
+// Read /LICENSE for more information.
+
+//
+// Created by Hedzr Yeh on 2021/10/20.
+//
+
+#include "design_patterns_cxx/dp-mediator.hh"
+#include "design_patterns_cxx/dp-x-test.hh"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace dp::bench::mediator {
+
+    struct sink : dp::mediator::colleague_t<std::uint64_t> {
+        ~sink() override { leave(); }
+        std::uint64_t count{}, sum{};
+        void on_message(std::uint64_t const &, std::uint64_t &&v) override {
+            count++;
+            sum += v;
+        }
+    };
+
+    // sends \a total messages from \a producers threads to \a sinks colleagues, returns messages per second.
+    inline double throughput(std::size_t workers, std::size_t producers, std::size_t sinks, std::size_t total) {
+        dp::mediator::mediator_t<std::uint64_t> m{workers, 1024, 1024};
+        std::vector<std::unique_ptr<sink>> ss;
+        for (std::size_t i = 0; i < sinks + producers; i++) {
+            ss.emplace_back(std::make_unique<sink>());
+            m.join(i, *ss.back());
+        }
+
+        auto per_producer = total / producers;
+        auto then = std::chrono::high_resolution_clock::now();
+        std::vector<std::thread> ts;
+        for (std::size_t p = 0; p < producers; p++)
+            ts.emplace_back([&ss, p, sinks, per_producer] {
+                auto &from = *ss[sinks + p];
+                for (std::size_t i = 0; i < per_producer; i++)
+                    from.send((i + p) % sinks, i);
+            });
+        for (auto &t : ts) t.join();
+        m.flush();
+        auto elapsed = std::chrono::high_resolution_clock::now() - then;
+
+        std::uint64_t got{};
+        for (std::size_t i = 0; i < sinks; i++) got += ss[i]->count;
+        if (got != per_producer * producers)
+            std::cerr << "  lost messages: " << (per_producer * producers - got) << '\n';
+        for (auto &s : ss) s->leave();
+        return double(got) / std::chrono::duration<double>(elapsed).count();
+    }
+
+} // namespace dp::bench::mediator
+
+void bench_mediator_throughput() {
+    using namespace dp::bench::mediator;
+    constexpr std::size_t total = 2'000'000;
+    std::size_t cores = std::max(2u, std::thread::hardware_concurrency());
+
+    std::printf("%8s %10s %8s %16s\n", "workers", "producers", "sinks", "msgs/s");
+    for (auto [workers, producers, sinks] : {std::tuple<std::size_t, std::size_t, std::size_t>{0, 1, 64},
+                                             {1, 1, 64},
+                                             {cores / 2, cores / 2, 64},
+                                             {cores / 2, cores / 2, 1024}}) {
+        if (workers == 0) {
+            // no workers: the producer delivers by polling whenever a mailbox fills up
+            std::printf("%8s %10zu %8zu %16.0f\n", "poll", producers, sinks, throughput(0, producers, sinks, total));
+            continue;
+        }
+        std::printf("%8zu %10zu %8zu %16.0f\n", workers, producers, sinks, throughput(workers, producers, sinks, total));
+    }
+}
+
+int main() {
+    DP_TEST_FOR(bench_mediator_throughput);
+    return 0;
+}
@@ -0,0 +1,159 @@
+// design_patterns_cxx Library
+// Copyright © 2021 Hedzr Yeh.
+//
+// This file is released under the terms of the MIT license.
+// Read /LICENSE for more information.
+
+//
+// Created by Hedzr Yeh on 2021/10/20.
+//
+
+#include "design_patterns_cxx/dp-tree.hh"
+
+#include "design_patterns_cxx/dp-x-test.hh"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <map>
+#include <numeric>
+#include <random>
+#include <set>
+#include <vector>
+
+namespace dp::bench::rb_tree {
+
+  template<typename F>
+  inline double ms(F &&fn) {
+    auto then = std::chrono::high_resolution_clock::now();
+    fn();
+    return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - then).count();
+  }
+
+  struct result {
+    double insert, lookup, iterate;
+    std::size_t checksum;
+  };
+
+  // inserts the keys, looks each one up and walks the container in order.
+  // \a key_of maps an element of the container to its key, for std::map.
+  template<typename C, typename Insert, typename Key>
+  inline result run(std::vector<int> const &keys, Insert &&insert, Key &&key_of) {
+    C c;
+    result r{};
+    r.insert = ms([&] {
+      for (auto k : keys) insert(c, k);
+    });
+    r.lookup = ms([&] {
+      for (auto k : keys) r.checksum += c.find(k) != c.end();
+    });
+    r.iterate = ms([&] {
+      for (int round = 0; round < 10; round++)
+        for (auto const &v : c) r.checksum += (std::size_t) key_of(v);
+    });
+    return r;
+  }
+
+} // namespace dp::bench::rb_tree
+
+void bench_rb_tree() {
+  using namespace dp::bench::rb_tree;
+  constexpr int n = 100'000;
+  std::vector<int> keys(n);
+  std::iota(keys.begin(), keys.end(), 0);
+  std::shuffle(keys.begin(), keys.end(), std::mt19937{42});
+
+  auto by_key = [](int v) { return v; };
+  auto set_insert = [](auto &c, int k) { c.insert(k); };
+  using rb = dp::tree::rb_tree<int>;
+  using rb_slab = dp::tree::rb_tree<int, dp::tree::detail::rb_node_t<int>, dp::tree::slab_allocator<int>>;
+  using os_rb = dp::tree::os_rb_tree<int>;
+
+  std::printf("%-24s %12s %12s %14s\n", "container", "insert ms", "lookup ms", "iterate ms x10");
+  auto print = [](char const *name, result const &r) {
+    std::printf("%-24s %12.2f %12.2f %14.2f\n", name, r.insert, r.lookup, r.iterate);
+    return r.checksum;
+  };
+  auto expect = print("std::set", run<std::set<int>>(keys, set_insert, by_key));
+  auto m = print("std::map", run<std::map<int, int>>(keys, [](auto &c, int k) { c.emplace(k, k); }, [](auto const &kv) { return kv.first; }));
+  auto a = print("rb_tree", run<rb>(keys, set_insert, by_key));
+  auto b = print("rb_tree (slab_allocator)", run<rb_slab>(keys, set_insert, by_key));
+  auto c = print("os_rb_tree", run<os_rb>(keys, set_insert, by_key));
+  auto d = print("btree", run<dp::tree::btree<int>>(keys, set_insert, by_key));
+  if (m != expect || a != expect || b != expect || c != expect || d != expect)
+    std::fprintf(stderr, "  the containers disagree\n");
+}
+
+void bench_rb_tree_bulk() {
+  using namespace dp::bench::rb_tree;
+  using rb = dp::tree::rb_tree<int>;
+  constexpr int n = 1'000'000;
+  std::vector<int> keys(n);
+  std::iota(keys.begin(), keys.end(), 0);
+
+  std::size_t sizes{};
+  std::printf("%-32s %12s\n", "load of sorted keys", "ms");
+  std::printf("%-32s %12.2f\n", "std::set, insert at end()", ms([&] {
+                std::set<int> s;
+                for (auto k : keys) s.insert(s.end(), k);
+                sizes += s.size();
+              }));
+  std::printf("%-32s %12.2f\n", "rb_tree, insert one by one", ms([&] {
+                rb t;
+                for (auto k : keys) t.insert(k);
+                sizes += t.size();
+              }));
+  std::printf("%-32s %12.2f\n", "rb_tree::from_sorted", ms([&] {
+                auto t = rb::from_sorted(keys.begin(), keys.end());
+                sizes += t.size();
+              }));
+  std::printf("%-32s %12.2f\n", "rb_tree::merge, two halves", ms([&] {
+                auto t = rb::from_sorted(keys.begin(), keys.begin() + n / 2);
+                t.merge(rb::from_sorted(keys.begin() + n / 2, keys.end()));
+                sizes += t.size();
+              }));
+  if (sizes != 4 * keys.size())
+    std::fprintf(stderr, "  bad sizes\n");
+}
+
+void bench_range_scan() {
+  using namespace dp::bench::rb_tree;
+  constexpr int n = 200'000, queries = 2'000, span = 1'000;
+  std::vector<int> keys(n);
+  std::iota(keys.begin(), keys.end(), 0);
+  std::shuffle(keys.begin(), keys.end(), std::mt19937{42});
+  std::vector<int> from(queries);
+  std::mt19937 rng{7};
+  for (auto &f : from) f = int(rng() % (n - span));
+
+  // sums the keys in [f, f + span) for each query
+  auto scan = [&from](auto const &c) {
+    long long sum{};
+    for (auto f : from)
+      for (auto it = c.lower_bound(f); it != c.end() && *it < f + span; ++it)
+        sum += *it;
+    return sum;
+  };
+  auto measure = [&keys, &scan](char const *name, auto &&c) {
+    for (auto k : keys) c.insert(k);
+    long long sum{};
+    auto t = ms([&] { sum = scan(c); });
+    std::printf("%-24s %12.2f\n", name, t);
+    return sum;
+  };
+
+  std::printf("%-24s %12s\n", "range scans, shuffled", "ms");
+  auto expect = measure("std::set", std::set<int>{});
+  auto a = measure("rb_tree", dp::tree::rb_tree<int>{});
+  auto b = measure("btree", dp::tree::btree<int>{});
+  auto c = measure("btree, 1KB nodes", dp::tree::btree<int, std::less<int>, std::allocator<int>, 1024>{});
+  if (a != expect || b != expect || c != expect)
+    std::fprintf(stderr, "  the containers disagree\n");
+}
+
+int main() {
+  DP_TEST_FOR(bench_rb_tree);
+  DP_TEST_FOR(bench_rb_tree_bulk);
+  DP_TEST_FOR(bench_range_scan);
+  return 0;
+}
@@ -0,0 +1,70 @@
+// design_patterns_cxx Library
+// Copyright © 2021 Hedzr Yeh.
+//
+// This file is released under the terms of the MIT license.
+// Read /LICENSE for more information.
+
+//
+// Created by Hedzr Yeh on 2021/10/20.
+//
+
+#include "design_patterns_cxx/dp-common.hh"
+#include "design_patterns_cxx/dp-util.hh"
+#include "design_patterns_cxx/dp-x-test.hh"
+
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <vector>
+
+namespace dp::bench::signal {
+
+    struct receiver {
+        long sum{};
+        void on(int const &v) { sum += v; }
+    };
+
+    template<typename F>
+    inline double ns_per_emit(std::size_t rounds, F &&emit) {
+        auto then = std::chrono::high_resolution_clock::now();
+        for (std::size_t i = 0; i < rounds; i++)
+            emit(int(i & 0xff));
+        auto elapsed = std::chrono::high_resolution_clock::now() - then;
+        return double(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()) / double(rounds);
+    }
+
+} // namespace dp::bench::signal
+
+void bench_signal_emit() {
+    using namespace dp::bench::signal;
+    constexpr std::size_t calls = 1'000'000;
+
+    std::printf("%8s %14s %26s %22s\n", "slots", "signal (ns)", "observable_bindable (ns)", "inplace_signal (ns)");
+    for (std::size_t slots : {1, 8, 64}) {
+        std::vector<receiver> rs(slots);
+        std::size_t rounds = calls / slots;
+
+        dp::util::signal<int> sig;
+        dp::util::observable_bindable<int> ob;
+        dp::util::inplace_signal<int> isig;
+        for (auto &r : rs) {
+            sig.connect(&receiver::on, &r);
+            ob.add_callback(&receiver::on, &r);
+            isig.connect(&receiver::on, &r);
+        }
+
+        auto t1 = ns_per_emit(rounds, [&sig](int v) { sig.emit(std::move(v)); });
+        auto t2 = ns_per_emit(rounds, [&ob](int v) { ob.emit(v); });
+        auto t3 = ns_per_emit(rounds, [&isig](int v) { isig.emit(v); });
+        std::printf("%8zu %14.2f %26.2f %22.2f\n", slots, t1, t2, t3);
+
+        long total{};
+        for (auto &r : rs) total += r.sum;
+        std::cout << "  (checksum " << total << ")\n";
+    }
+}
+
+int main() {
+    DP_TEST_FOR(bench_signal_emit);
+    return 0;
+}
@@ -0,0 +1,139 @@
+// design_patterns_cxx Library
+// Copyright © 2021 Hedzr Yeh.
+//
+// This file is released under the terms of the MIT license.
+// Read /LICENSE for more information.
+
+//
+// Created by Hedzr Yeh on 2021/10/20.
+//
+
+#include "design_patterns_cxx/dp-common.hh"
+#include "design_patterns_cxx/dp-x-test.hh"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace dp::bench::singleton {
+
+    struct config : dp::util::singleton<config> {
+        explicit config(dp::util::singleton<config>::token) {}
+        int value{1};
+    };
+
+    struct plain {
+        plain() = default;
+        explicit plain(int v)
+            : value(v) {}
+        int value{1};
+    };
+
+    // records the order the instances die in
+    inline std::string &deaths() {
+        static std::string d;
+        return d;
+    }
+    template<char Name>
+    struct traced {
+        ~traced() { deaths() += Name; }
+    };
+
+    // calls \a get on each of \a threads threads, returns the nanoseconds per call
+    template<typename Get>
+    inline double ns_per_call(std::size_t threads, Get &&get) {
+        constexpr int n = 10'000'000;
+        std::atomic<long> total{};
+        auto then = std::chrono::high_resolution_clock::now();
+        std::vector<std::thread> ts;
+        for (std::size_t t = 0; t < threads; t++)
+            ts.emplace_back([&total, &get] {
+                long sum{};
+                for (int i = 0; i < n; i++) {
+                    sum += get().value;
+                    // keeps the compiler from hoisting the call out of the loop
+                    std::atomic_signal_fence(std::memory_order_seq_cst);
+                }
+                total += sum;
+            });
+        for (auto &t : ts) t.join();
+        auto elapsed = std::chrono::high_resolution_clock::now() - then;
+        if (total != long(threads) * n)
+            std::fprintf(stderr, "  bad sum\n");
+        return std::chrono::duration<double, std::nano>(elapsed).count() / n;
+    }
+
+} // namespace dp::bench::singleton
+
+void test_static_singleton() {
+    using namespace dp::bench::singleton;
+    using dp::util::static_singleton;
+
+    DP_TEST_CHECK(!static_singleton<plain>::alive(), "not started yet");
+    DP_TEST_CHECK(static_singleton<plain>::startup(7)->value == 7, "bad startup");
+    DP_TEST_CHECK(static_singleton<plain>::startup(8)->value == 7 && &static_singleton<plain>::instance() == static_singleton<plain>::startup(), "startup must make the instance once");
+
+    // shut down in the reverse order of startup, not of first use
+    static_singleton<traced<'a'>>::startup();
+    static_singleton<traced<'b'>>::instance();
+    static_singleton<traced<'c'>>::instance();
+    dp::util::shutdown_static_singletons();
+    DP_TEST_CHECK(deaths() == "cba" && !static_singleton<plain>::alive(), "bad shutdown order");
+    DP_TEST_CHECK(static_singleton<plain>::instance().value == 1, "an instance may be made again after shutdown");
+    static_singleton<plain>::shutdown();
+
+    // made again after shutdown, it's listed and destroyed once, in its new startup order
+    auto &lifetimes = dp::util::detail::singleton_lifetimes::get();
+    DP_TEST_CHECK(lifetimes.size() == 0, "a shut down singleton must not stay listed");
+    deaths().clear();
+    static_singleton<traced<'d'>>::startup();
+    static_singleton<traced<'e'>>::startup();
+    static_singleton<traced<'d'>>::shutdown();
+    for (int i = 0; i < 3; i++) {
+        static_singleton<traced<'d'>>::instance();
+        static_singleton<traced<'d'>>::shutdown();
+    }
+    static_singleton<traced<'d'>>::instance();
+    DP_TEST_CHECK(lifetimes.size() == 2, "a singleton made again must be listed once");
+    dp::util::shutdown_static_singletons();
+    DP_TEST_CHECK(deaths() == "ddddde" && lifetimes.size() == 0, "bad shutdown after a restart");
+
+    // one instance per thread
+    plain *mine = &dp::util::thread_singleton<plain>::instance(), *theirs{};
+    std::thread t([&theirs] { theirs = &dp::util::thread_singleton<plain>::instance(); });
+    t.join();
+    DP_TEST_CHECK(mine != theirs && mine == &dp::util::thread_singleton<plain>::instance(), "bad thread_singleton");
+
+    // racing first calls make one instance
+    std::vector<std::thread> ts;
+    std::vector<plain *> got(8);
+    for (std::size_t i = 0; i < got.size(); i++)
+        ts.emplace_back([&got, i] { got[i] = &dp::util::singleton_with_optional_construction_args<plain, int>::instance(int(i)); });
+    for (auto &th : ts) th.join();
+    DP_TEST_CHECK(std::all_of(got.begin(), got.end(), [&got](plain *p) { return p == got[0]; }), "singleton_with_optional_construction_args made several instances");
+}
+
+void bench_singleton() {
+    using namespace dp::bench::singleton;
+    std::size_t cores = std::max(2u, std::thread::hardware_concurrency());
+
+    std::printf("%8s %16s %16s %16s %16s\n", "threads", "singleton", "static_singleton", "thread_singleton", "with_args");
+    for (std::size_t threads = 1; threads <= cores; threads *= 2) {
+        auto a = ns_per_call(threads, [] () -> config & { return config::instance(); });
+        auto b = ns_per_call(threads, [] () -> plain & { return dp::util::static_singleton<plain>::instance(); });
+        auto c = ns_per_call(threads, [] () -> plain & { return dp::util::thread_singleton<plain>::instance(); });
+        auto d = ns_per_call(threads, [] () -> plain & { return dp::util::singleton_with_optional_construction_args<plain>::instance(); });
+        std::printf("%8zu %13.2f ns %13.2f ns %13.2f ns %13.2f ns\n", threads, a, b, c, d);
+    }
+    dp::util::shutdown_static_singletons();
+}
+
+int main() {
+    DP_TEST_FOR(test_static_singleton);
+    DP_TEST_FOR(bench_singleton);
+    return 0;
+}
@@ -7,6 +7,7 @@
 #include "design_patterns_cxx/dp-util.hh"
 #include "design_patterns_cxx/dp-x-test.hh"
 
+#include <chrono>
 #include <iomanip>
 #include <iostream>
 #include <math.h>
@@ -21,6 +22,7 @@
 #include <optional>
 #include <queue>
 #include <stack>
+#include <thread>
 #include <vector>
 
 
@@ -315,6 +317,170 @@ void test_9() {
     p->run();
 }
 
+///////////////////////////////////////////////////////////////////
+
+namespace tmp2 {
+    struct Msg {
+        virtual ~Msg() = default;
+        virtual int kind() const = 0;
+    };
+    struct Login : Msg {
+        int kind() const override { return 1; }
+    };
+    struct Logout : Msg {
+        int kind() const override { return 2; }
+    };
+    struct Ping : Msg {
+        int kind() const override { return 3; }
+    };
+    struct Pong : Msg {
+        int kind() const override { return 4; }
+    };
+    struct Data : Msg {
+        Data() = default;
+        explicit Data(std::string s)
+            : payload(std::move(s)) {}
+        int kind() const override { return 5; }
+        std::string payload{};
+    };
+} // namespace tmp2
+
+void test_factory_lookup() {
+    using namespace tmp2;
+    using msg_factory = dp::util::factory::factory<Msg, Login, Logout, Ping, Pong, Data>;
+
+    int kinds = 0;
+    for (auto id : {"tmp2::Login", "tmp2::Logout", "tmp2::Ping", "tmp2::Pong", "tmp2::Data"})
+        kinds = kinds * 10 + msg_factory::create(id)->kind();
+    assertm(kinds == 12345, "bad lookup");
+    assertm(!msg_factory::create("tmp2::Msg") && !msg_factory::create("") && !msg_factory::create("tmp2::Pin"), "unknown ids must yield nullptr");
+
+    // only Data can be made from a string
+    auto d = msg_factory::create("tmp2::Data", std::string{"hello"});
+    assertm(d && static_cast<Data *>(d.get())->payload == "hello", "bad args");
+    assertm(!msg_factory::create("tmp2::Ping", std::string{"hello"}), "Ping has no such constructor");
+
+    constexpr int n = 1'000'000;
+    auto then = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < n; i++)
+        kinds += msg_factory::create(i % 2 ? "tmp2::Pong" : "tmp2::Logout")->kind();
+    auto ns = std::chrono::duration<double, std::nano>(std::chrono::high_resolution_clock::now() - then).count() / n;
+    std::cout << "  create: " << ns << " ns" << '\n';
+}
+
+namespace tmp2 {
+    // counts the allocations made through it
+    template<typename T>
+    struct counting_allocator {
+        using value_type = T;
+        int *count;
+        explicit counting_allocator(int *count_)
+            : count(count_) {}
+        template<typename U>
+        counting_allocator(counting_allocator<U> const &o)
+            : count(o.count) {}
+        T *allocate(std::size_t n) {
+            ++*count;
+            return std::allocator<T>{}.allocate(n);
+        }
+        void deallocate(T *p, std::size_t n) { std::allocator<T>{}.deallocate(p, n); }
+        template<typename U>
+        bool operator==(counting_allocator<U> const &o) const { return count == o.count; }
+        template<typename U>
+        bool operator!=(counting_allocator<U> const &o) const { return count != o.count; }
+    };
+
+    struct Traced : Msg {
+        explicit Traced(std::vector<int> &log_, int id_)
+            : log(log_), id(id_) {}
+        ~Traced() override { log.push_back(id); }
+        int kind() const override { return 6; }
+        std::vector<int> &log;
+        int id;
+    };
+} // namespace tmp2
+
+void test_factory_policies() {
+    using namespace tmp2;
+    using msg_factory = dp::util::factory::factory<Msg, Ping, Data, Traced>;
+
+    // the product and its control block come in one allocation
+    int allocations = 0;
+    auto sp = msg_factory::allocate_shared(counting_allocator<Msg>{&allocations}, "tmp2::Data", std::string{"hi"});
+    DP_TEST_CHECK(sp && sp->kind() == 5 && allocations == 1, "allocate_shared must allocate once");
+    DP_TEST_CHECK(msg_factory::make_shared("tmp2::Ping")->kind() == 3, "bad make_shared");
+
+    // a recycled block is handed out again
+    Msg *first{};
+    {
+        auto p = msg_factory::create_pooled("tmp2::Ping");
+        first = p.get();
+    }
+    auto again = msg_factory::create_pooled("tmp2::Ping");
+    DP_TEST_CHECK(again.get() == first && again->kind() == 3, "the pool must reuse the freed block");
+    DP_TEST_CHECK(!msg_factory::create_pooled("tmp2::Pong"), "unknown ids must yield nullptr");
+
+    // the arena destroys its products in reverse order on release()
+    std::vector<int> log;
+    dp::util::factory::monotonic_arena arena{256};
+    for (int i = 0; i < 100; i++) {
+        auto *m = msg_factory::create_in(arena, "tmp2::Traced", log, i);
+        DP_TEST_CHECK(m && m->kind() == 6, "bad create_in");
+    }
+    auto *d = msg_factory::create_in(arena, "tmp2::Data", std::string(1000, 'x'));
+    DP_TEST_CHECK(static_cast<Data *>(d)->payload.size() == 1000, "bad create_in with args");
+    arena.release();
+    DP_TEST_CHECK(log.size() == 100 && log.front() == 99 && log.back() == 0, "the arena must destroy its products in reverse order");
+    msg_factory::create_in(arena, "tmp2::Traced", log, 100);
+
+    // release() keeps the biggest block, so the rounds settle in it rather than growing
+    struct big {
+        char bytes[3000];
+    };
+    dp::util::factory::monotonic_arena rounds{4096};
+    void *settled{};
+    for (int round = 0; round < 1000; round++) {
+        auto *b = rounds.make<big>();
+        rounds.make<big>();
+        if (round == 1) settled = b;
+        DP_TEST_CHECK(round < 1 || b == settled, "the rounds must reuse the kept block");
+        rounds.release();
+    }
+}
+
+void test_factory_registry() {
+    using namespace tmp2;
+    using msg_registry = dp::util::factory::registry<Msg>;
+    msg_registry reg;
+
+    assertm(reg.add<Login>() && reg.add<Logout>() && reg.add<Ping>("ping") && !reg.add<Ping>("ping"), "bad add");
+    assertm(reg.create("tmp2::Login")->kind() == 1 && reg.make_unique("tmp2::Logout")->kind() == 2, "bad create");
+    assertm(reg.make_shared("ping")->kind() == 3 && !reg.create("tmp2::Ping"), "bad make_shared");
+
+    // an id may be interned before a plugin registers it
+    auto pong = reg.intern("pong");
+    assertm(pong && !reg.create(pong) && !reg.contains("pong"), "an interned id is not registered yet");
+    reg.add("pong", [] { return std::unique_ptr<Msg>{std::make_unique<Pong>()}; });
+    assertm(reg.create(pong)->kind() == 4 && reg.find("pong") == pong, "bad add by creator");
+
+    auto batch = reg.create_n(pong, 10);
+    assertm(batch.size() == 10 && reg.created(pong) == 11 && reg.created("ping") == 1, "bad counters");
+    assertm(reg.remove("ping") && !reg.create("ping") && reg.size() == 3, "bad remove");
+
+    // lookups run while other threads register products
+    std::atomic<bool> stop{};
+    std::atomic<int> made{};
+    std::thread reader([&reg, &stop, &made] {
+        while (!stop)
+            made += reg.create("tmp2::Login") != nullptr;
+    });
+    for (int i = 0; i < 200; i++)
+        reg.add<Data>("data#" + std::to_string(i));
+    stop = true;
+    reader.join();
+    assertm(reg.size() == 203 && reg.created("tmp2::Login") == 1 + std::uint64_t(made), "bad concurrent registration");
+}
+
 
 ///////////////////////////////////////////////////////////////////
 
@@ -330,6 +496,9 @@ int main() {
     DP_TEST_FOR(test_factory_abstract);
 
     DP_TEST_FOR(test_9);
+    DP_TEST_FOR(test_factory_lookup);
+    DP_TEST_FOR(test_factory_policies);
+    DP_TEST_FOR(test_factory_registry);
     
     return 0;
 }
\ No newline at end of file
@@ -9,6 +9,7 @@
 //
 
 #include "design_patterns_cxx/dp-mediator.hh"
+#include "design_patterns_cxx/dp-resp-chain.hh" // they may be included together
 
 #include "design_patterns_cxx/dp-def.hh"
 
@@ -31,6 +32,7 @@
 #include <atomic>
 #include <condition_variable>
 #include <mutex>
+#include <thread>
 
 #include <any>
 #include <array>
@@ -43,6 +45,7 @@
 #include <unordered_map>
 #include <vector>
 
+#include <cassert>
 #include <cstdio>
 #include <cstdlib>
 #include <iomanip>
@@ -53,14 +56,200 @@
 
 namespace dp::mediator::test {
 
+    struct msg {
+        int seq{};
+        std::string text{};
+    };
+
+    // records what it gets, and checks the order of each sender's messages
+    class peer : public colleague_t<msg> {
+    public:
+        ~peer() override { leave(); }
+        std::atomic<int> received{};
+        std::atomic<int> broadcasts{};
+        std::atomic<int> out_of_order{};
+        std::map<std::uint64_t, int> last_seq{};
+        std::vector<std::string> texts{};
+
+    protected:
+        void on_message(std::uint64_t const &from, msg &&m) override {
+            if (m.seq < 0) {
+                broadcasts++;
+                return;
+            }
+            auto &last = last_seq[from];
+            if (m.seq <= last && last != 0) out_of_order++;
+            last = m.seq;
+            if (!m.text.empty()) texts.push_back(std::move(m.text));
+            received++;
+        }
+    };
+
+    // answers every message by sending it back, until its seq reaches the limit
+    class ponger : public colleague_t<msg> {
+    public:
+        ~ponger() override { leave(); }
+        int limit{1000};
+        std::atomic<int> hits{};
+
+    protected:
+        void on_message(std::uint64_t const &from, msg &&m) override {
+            hits++;
+            if (m.seq < limit) send(from, msg{m.seq + 1});
+        }
+    };
+
+    // floods another one on its first message, to fill up each other's mailboxes
+    class flooder : public colleague_t<msg> {
+    public:
+        ~flooder() override { leave(); }
+        std::uint64_t peer{};
+        std::atomic<int> received{};
+        std::atomic<int> out_of_order{};
+
+    protected:
+        void on_message(std::uint64_t const &, msg &&m) override {
+            if (m.seq == 0)
+                for (int i = 1; i <= 200; i++) send(peer, msg{i});
+            else if (m.seq != ++last)
+                out_of_order++;
+            received++;
+        }
+
+    private:
+        int last{};
+    };
+
 } // namespace dp::mediator::test
 
 void test_mediator() {
     using namespace dp::mediator;
+    using test::msg;
+
+    mediator_t<msg> m{4};
+    test::peer a, b, c;
+    assert(m.join(1, a) && m.join(2, b) && m.join(3, c));
+    assert(!m.join(1, b) && !m.join(4, a)); // the id is taken, a has joined already
+    assert(m.size() == 3 && m.contains(2) && !m.contains(4));
+
+    assert(a.send(2, msg{1, "hello"}));
+    assert(!a.send(9, msg{1, "nobody"}));
+    assert(a.broadcast(msg{-1}) == 2);
+    m.flush();
+    assert(b.received == 1 && b.texts.size() == 1 && b.texts[0] == "hello");
+    assert(b.broadcasts == 1 && c.broadcasts == 1 && a.broadcasts == 0);
+
+    // several threads sending to the same colleagues, in order per sender
+    constexpr int per_thread = 20000;
+    std::vector<std::thread> senders;
+    std::vector<std::unique_ptr<test::peer>> srcs;
+    for (int t = 0; t < 4; t++) {
+        srcs.emplace_back(std::make_unique<test::peer>());
+        m.join(100 + t, *srcs.back());
+    }
+    for (int t = 0; t < 4; t++)
+        senders.emplace_back([&srcs, t] {
+            for (int i = 1; i <= per_thread; i++)
+                srcs[t]->send(1 + (i % 3), msg{i / 3 + 1});
+        });
+    for (auto &t : senders) t.join();
+    m.flush();
+    assert(a.received + b.received + c.received == 4 * per_thread + 1);
+    assert(a.out_of_order == 0 && b.out_of_order == 0 && c.out_of_order == 0);
+
+    // leave and join again
+    c.leave();
+    assert(!c.joined() && !m.contains(3) && !a.send(3, msg{1}));
+    assert(m.join(3, c) && c.joined());
+
+    // colleagues talking to each other on the workers
+    test::ponger p1, p2;
+    m.join(201, p1);
+    m.join(202, p2);
+    p1.send(202, msg{1});
+    while (p1.hits + p2.hits < 1000) std::this_thread::yield();
+    m.flush();
+    assert(p1.hits + p2.hits == 1000);
+
+    std::cout << "posted " << m.posted() << ", delivered " << m.delivered() << ", dropped " << m.dropped() << '\n';
+    for (auto &s : srcs) s->leave();
+}
+
+void test_mediator_poll() {
+    using namespace dp::mediator;
+    using test::msg;
+
+    // no workers, the messages are delivered by poll()
+    mediator_t<msg, std::string> m{0, 16, 4};
+    struct named : colleague_t<msg, std::string> {
+        ~named() override { leave(); }
+        std::vector<int> seqs{};
+        void on_message(std::string const &, msg &&v) override { seqs.push_back(v.seq); }
+    } x, y;
+    m.join("x", x);
+    m.join("y", y);
+
+    for (int i = 0; i < 10; i++) // more than the mailbox holds, the sender polls to make room
+        x.send("y", msg{i});
+    assert(y.seqs.size() >= 6);
+    m.flush();
+    assert(y.seqs.size() == 10 && std::is_sorted(y.seqs.begin(), y.seqs.end()));
+    assert(m.poll() == 0);
+}
+
+void test_mediator_overflow() {
+    using namespace dp::mediator;
+    using test::msg;
+
+    // two colleagues sending to each other's full mailbox on the workers, or on poll()
+    for (std::size_t workers : {2, 0}) {
+        mediator_t<msg> m{workers, 16, 4, 2};
+        test::flooder a, b;
+        m.join(1, a);
+        m.join(2, b);
+        a.peer = 2;
+        b.peer = 1;
+        m.send(0, 1, msg{0});
+        m.send(0, 2, msg{0});
+        do m.flush(); // the floods are posted after the flush began
+        while (m.delivered() < m.posted());
+        assert(a.received == 201 && b.received == 201);
+        assert(a.out_of_order == 0 && b.out_of_order == 0);
+        std::cout << "workers " << workers << ": delivered " << m.delivered() << '\n';
+    }
+}
+
+void test_mediator_stop() {
+    using namespace dp::mediator;
+    using test::msg;
 
+    // sends racing stop() on a tiny mailbox are delivered or refused, never stranded
+    for (int round = 0; round < 20; round++) {
+        mediator_t<msg> m{1, 16, 2, 1};
+        test::peer a;
+        m.join(1, a);
+        std::atomic<int> accepted{};
+        std::vector<std::thread> senders;
+        for (int t = 0; t < 4; t++)
+            senders.emplace_back([&m, &accepted, t] {
+                for (int i = 1; i <= 500; i++) {
+                    if (!m.send(std::uint64_t(t), 1, msg{i}))
+                        break;
+                    accepted++;
+                }
+            });
+        std::this_thread::sleep_for(std::chrono::microseconds(round * 50));
+        m.stop();
+        for (auto &th : senders) th.join();
+        DP_TEST_CHECK(m.posted() == std::uint64_t(accepted) && m.posted() == m.delivered() + m.dropped(), "a message posted must be delivered or dropped");
+        DP_TEST_CHECK(a.received == accepted && a.out_of_order == 0, "the accepted messages must be delivered in order");
+    }
 }
 
 int main() {
     using namespace std::string_view_literals;
     DP_TEST_FOR(test_mediator);
+    DP_TEST_FOR(test_mediator_poll);
+    DP_TEST_FOR(test_mediator_overflow);
+    DP_TEST_FOR(test_mediator_stop);
 }
\ No newline at end of file
@@ -16,6 +16,7 @@
 #include <atomic>
 #include <condition_variable>
 #include <mutex>
+#include <thread>
 
 #include <any>
 #include <array>
@@ -34,6 +35,7 @@
 #include <iostream>
 #include <string>
 
+#include <cassert>
 #include <math.h>
 
 #include "design_patterns_cxx/dp-def.hh"
@@ -79,6 +81,261 @@ void test_observer_basic() {
     store.emit(mouse_move_event{});
 }
 
+namespace dp::observer::rcu {
+
+    struct event {
+        int seq{};
+    };
+
+    class Store : public dp::util::observable_rcu<event> {};
+
+    class Customer : public dp::util::observer<event> {
+    public:
+        virtual ~Customer() {}
+        void observe(const subject_t &) override { _count++; }
+        std::size_t count() const { return _count.load(); }
+
+    private:
+        std::atomic<std::size_t> _count{};
+    };
+
+} // namespace dp::observer::rcu
+
+void test_observer_rcu() {
+    using namespace dp::observer::rcu;
+
+    Store store;
+    Store::observer_t_shared c1 = std::make_shared<Customer>();
+    Store::observer_t_shared c2 = std::make_shared<Customer>();
+    store += c1;
+
+    const int publishers = 4, rounds = 10000;
+    std::vector<std::thread> threads;
+    for (int i = 0; i < publishers; i++)
+        threads.emplace_back([&store, i] {
+            for (int j = 0; j < rounds; j++)
+                store.emit(event{i * rounds + j});
+        });
+    // registration goes on while the publishers are emitting
+    for (int j = 0; j < 100; j++) {
+        store += c2;
+        store -= c2;
+    }
+    for (auto &t : threads) t.join();
+
+    auto *cust = static_cast<Customer *>(c1.get());
+    std::cout << "c1 received " << cust->count() << " events, c2 received " << static_cast<Customer *>(c2.get())->count() << '\n';
+    assert(cust->count() == publishers * rounds);
+    assert(store.size() == 1);
+
+    {
+        // the expired observers are pruned at the next removal
+        Store::observer_t_shared tmp = std::make_shared<Customer>();
+        store += tmp;
+        tmp.reset();
+        store -= c2;
+        assert(store.size() == 1);
+    }
+    UNUSED(cust);
+}
+
+namespace dp::observer::async {
+
+    struct event {
+        int seq{};
+    };
+
+    class Customer : public dp::util::observer<event> {
+    public:
+        explicit Customer(int delay_us = 0)
+            : _delay_us(delay_us) {}
+        virtual ~Customer() {}
+        void observe(const subject_t &e) override {
+            if (_delay_us)
+                std::this_thread::sleep_for(std::chrono::microseconds(_delay_us));
+            if (e.seq < _last) _out_of_order++;
+            _last = e.seq;
+            _count++;
+        }
+        std::size_t count() const { return _count.load(); }
+        std::size_t out_of_order() const { return _out_of_order; }
+
+    private:
+        int _delay_us;
+        int _last{-1};
+        std::size_t _out_of_order{};
+        std::atomic<std::size_t> _count{};
+    };
+
+} // namespace dp::observer::async
+
+void test_observer_async() {
+    using namespace dp::observer::async;
+    using Store = dp::util::observable_async<event>;
+
+    {
+        Store store{16, dp::util::backpressure::block, 8};
+        Store::observer_t_shared c1 = std::make_shared<Customer>();
+        Store::observer_t_shared c2 = std::make_shared<Customer>(5);
+        store += c1;
+        store += c2;
+        for (int i = 0; i < 200; i++)
+            store.emit(event{i});
+        store.flush();
+        auto *cust = static_cast<Customer *>(c2.get());
+        std::cout << "block: slow observer received " << cust->count() << " events" << '\n';
+        assert(cust->count() == 200 && cust->out_of_order() == 0);
+        assert(static_cast<Customer *>(c1.get())->count() == 200);
+        assert(store.dropped() == 0 && store.pending() == 0);
+        UNUSED(cust);
+    }
+
+    for (auto policy : {dp::util::backpressure::drop_newest, dp::util::backpressure::drop_oldest}) {
+        Store store{4, policy, 2};
+        Store::observer_t_shared c = std::make_shared<Customer>(200);
+        store += c;
+        for (int i = 0; i < 100; i++)
+            store.emit(event{i});
+        store.flush();
+        auto *cust = static_cast<Customer *>(c.get());
+        std::cout << (policy == dp::util::backpressure::drop_newest ? "drop_newest" : "drop_oldest")
+                  << ": received " << cust->count() << ", dropped " << store.dropped() << '\n';
+        assert(cust->count() + store.dropped() == 100 && store.dropped() > 0);
+        assert(cust->out_of_order() == 0);
+        UNUSED(cust);
+    }
+
+    {
+        Store store;
+        Store::observer_t_shared c = std::make_shared<Customer>();
+        store += c;
+        std::vector<std::thread> threads;
+        for (int i = 0; i < 4; i++)
+            threads.emplace_back([&store] {
+                for (int j = 0; j < 5000; j++)
+                    store.emit(event{});
+            });
+        for (auto &t : threads) t.join();
+        store.flush();
+        assert(static_cast<Customer *>(c.get())->count() == 20000);
+    }
+
+    // more blocked publishers than room in the ring, and a stop() racing
+    // them: every event accepted is delivered, and no publisher hangs
+    for (int round = 0; round < 20; round++) {
+        Store store{2, dp::util::backpressure::block, 1};
+        Store::observer_t_shared c = std::make_shared<Customer>();
+        store += c;
+        std::atomic<std::size_t> accepted{};
+        std::vector<std::thread> threads;
+        for (int i = 0; i < 8; i++)
+            threads.emplace_back([&store, &accepted] {
+                for (int j = 0; j < 500; j++)
+                    accepted += store.emit(event{});
+            });
+        std::this_thread::sleep_for(std::chrono::microseconds(round * 50));
+        store.stop();
+        for (auto &t : threads) t.join();
+        assert(static_cast<Customer *>(c.get())->count() == accepted.load());
+    }
+}
+
+namespace dp::observer::tracked {
+
+    struct event {};
+
+    class Customer : public dp::util::observer<event> {
+    public:
+        virtual ~Customer() {}
+        void observe(const subject_t &) override { count++; }
+        std::size_t count{};
+    };
+
+    class Quitter : public Customer {
+    public:
+        dp::util::observable_tracked<event> *store{};
+        dp::util::subscription self{};
+        void observe(const subject_t &e) override {
+            Customer::observe(e);
+            store->unsubscribe(self); // leave from within the emission
+        }
+    };
+
+} // namespace dp::observer::tracked
+
+void test_observer_tracked() {
+    using namespace dp::observer::tracked;
+    using Store = dp::util::observable_tracked<event>;
+
+    Store store;
+    auto c1 = std::make_shared<Customer>(), c2 = std::make_shared<Customer>();
+    auto id1 = store.subscribe(c1);
+    auto id2 = store.subscribe(c2);
+    store.emit(event{});
+    DP_TEST_CHECK(c1->count == 1 && c2->count == 1, "bad emit");
+
+    DP_TEST_CHECK(store.unsubscribe(id1), "bad unsubscribe");
+    DP_TEST_CHECK(!store.unsubscribe(id1), "unsubscribed twice");
+    auto id3 = store.subscribe(c1); // reuses the slot of id1 with a new generation
+    DP_TEST_CHECK(id3.index == id1.index && id3 != id1, "the slot was not reused");
+    DP_TEST_CHECK(!store.contains(id1) && store.contains(id3), "a stale handle is alive");
+
+    auto q = std::make_shared<Quitter>();
+    q->store = &store;
+    q->self = store.subscribe(q);
+    store.emit(event{});
+    store.emit(event{});
+    DP_TEST_CHECK(q->count == 1 && c2->count == 3, "bad emit after leaving");
+    DP_TEST_CHECK(!store.contains(q->self) && store.size() == 2, "the quitter is still there");
+
+    // an observer owned by the store only stays subscribed
+    std::vector<dp::util::subscription> ids;
+    for (int i = 0; i < 100; i++)
+        ids.push_back(store.subscribe(std::make_shared<Customer>()));
+    store.sweep();
+    store.emit(event{});
+    std::cout << "observers alive after sweep: " << store.size() << '\n';
+    DP_TEST_CHECK(store.size() == 102 && store.contains(id2) && c2->count == 4, "an owned observer was dropped");
+    for (auto const &id : ids)
+        DP_TEST_CHECK(store.unsubscribe(id), "bad unsubscribe");
+    DP_TEST_CHECK(store.size() == 2, "bad unsubscribe");
+
+    // a weak observer dying without unsubscribing is dropped by the next emission
+    auto w = std::make_shared<Customer>();
+    auto wid = store.subscribe_weak(w);
+    store.emit(event{});
+    DP_TEST_CHECK(w->count == 1 && store.contains(wid) && store.size() == 3, "bad weak subscription");
+    w.reset();
+    DP_TEST_CHECK(!store.contains(wid), "an expired observer is alive");
+    store.emit(event{});
+    DP_TEST_CHECK(store.size() == 2 && c2->count == 6, "an expired observer was not compacted");
+
+    // or by subscribe(), once the array has doubled
+    for (int i = 0; i < 100; i++)
+        store.subscribe_weak(std::make_shared<Customer>());
+    std::cout << "observers alive after expiry: " << store.size() << '\n';
+    DP_TEST_CHECK(store.size() < 20 && store.contains(id2) && store.contains(id3), "the expired observers were not swept");
+    store.sweep();
+    DP_TEST_CHECK(store.size() == 2, "bad sweep");
+
+    // unsubscribing twice from within an emission succeeds once
+    struct Twice : Customer {
+        Store *store{};
+        dp::util::subscription self{};
+        int removed{};
+        void observe(const subject_t &e) override {
+            Customer::observe(e);
+            removed += store->unsubscribe(self);
+            removed += store->unsubscribe(self);
+        }
+    };
+    auto t = std::make_shared<Twice>();
+    t->store = &store;
+    t->self = store.subscribe(t);
+    store.emit(event{});
+    DP_TEST_CHECK(t->removed == 1 && !store.contains(t->self) && store.size() == 2, "bad unsubscribe twice");
+}
+
 namespace helpers {
 
     template<typename... Args>
@@ -337,14 +594,128 @@ void test_observer_slots_args() {
 #endif
 }
 
+void test_observer_signal_connections() {
+    dp::util::signal<int> sig;
+    int a{}, b{}, c{};
+
+    auto ca = sig.connect([&a](int v) { a += v; });
+    dp::util::connection cb;
+    cb = sig.connect([&b, &cb](int v) {
+        b += v;
+        cb.disconnect(); // a one-shot slot
+    });
+    {
+        dp::util::scoped_connection sc = sig.connect([&c](int v) { c += v; });
+        sig.emit(1);
+        DP_TEST_CHECK(sc.connected() && sig.size() == 2, "bad scoped connection");
+    }
+    sig.emit(2);
+    DP_TEST_CHECK(a == 3 && b == 1 && c == 1, "bad emit");
+    DP_TEST_CHECK(ca.connected() && !cb.connected() && sig.size() == 1, "bad disconnect");
+
+    // a slot disconnecting a later one during the emission
+    dp::util::connection victim;
+    sig.connect([&victim](int) { victim.disconnect(); });
+    victim = sig.connect([&c](int v) { c += v; });
+    sig.emit(4);
+    DP_TEST_CHECK(a == 7 && c == 1, "a slot disconnected during the emission was called");
+
+    // connects and disconnects on another thread while emitting
+    std::atomic<long> hits{};
+    std::atomic<bool> done{};
+    std::thread t([&sig, &hits, &done] {
+        for (int i = 0; i < 2000; i++) {
+            dp::util::scoped_connection sc = sig.connect([&hits](int) { hits++; });
+        }
+        done = true;
+    });
+    long rounds{};
+    while (!done.load()) {
+        sig.emit(0);
+        rounds++;
+    }
+    t.join();
+    std::cout << "emitted " << rounds << " times, transient slots hit " << hits.load() << " times" << '\n';
+    DP_TEST_CHECK(sig.size() == 2, "bad concurrent connects");
+
+    sig.clear();
+    DP_TEST_CHECK(!ca.connected() && sig.size() == 0, "bad clear");
+
+    // the connections chain, as the signal returned by connect() used to
+    int chained{};
+    auto last = sig.connect([&chained](int v) { chained += v; }).connect([&chained](int v) { chained += 10 * v; });
+    sig.emit(1);
+    DP_TEST_CHECK(chained == 11 && last.connected() && sig.size() == 2, "bad chained connect");
+    sig.clear();
+
+    // every slot sees the subjects intact, not a moved-from leftover
+    dp::util::signal<std::string> ssig;
+    std::vector<std::string> got;
+    for (int i = 0; i < 3; i++)
+        ssig.on([&got](std::string v) { got.push_back(std::move(v)); });
+    ssig.on([&got](std::string &&v) { got.push_back(std::move(v)); }); // gets a copy of its own
+    ssig.emit(std::string(64, 'x'));
+    DP_TEST_CHECK(got.size() == 4 && std::count(got.begin(), got.end(), std::string(64, 'x')) == 4, "a slot saw a moved-from subject");
+
+    // move-only subjects are shared by const reference
+    dp::util::signal<std::unique_ptr<int>> usig;
+    int sum{};
+    for (int i = 0; i < 2; i++)
+        usig.on([&sum](std::unique_ptr<int> const &p) { sum += *p; });
+    usig.emit(std::make_unique<int>(3));
+    DP_TEST_CHECK(sum == 6, "bad move-only subject");
+}
+
+void test_observer_inplace_signal() {
+    using namespace dp::observer::slots::tests;
+
+    struct foo {
+        int sum{};
+        void bar(float f, int i, std::string const &str) {
+            sum += i;
+            std::cout << "mem-fn: " << f << ' ' << i << ' ' << str << '\n';
+        }
+        void cbar(float, int, std::string const &) const { std::cout << "const mem-fn" << '\n'; }
+        static void sbar(float, int i, std::string const &) { std::cout << "static mem-fn: " << i << '\n'; }
+    };
+
+    dp::util::inplace_signal<float, int, std::string> sig;
+    foo ff;
+    int calls{};
+    sig.connect(&foo::bar, &ff);
+    sig.connect(&foo::cbar, ff);
+    sig.connect(&foo::sbar);
+    sig.on([&calls](float, int, std::string const &) { calls++; });
+    sig.on([](auto a, auto &&...args) {
+        std::cout << "generic lambda: " << a;
+        ((std::cout << ' ' << args), ...);
+        std::cout << '\n';
+    });
+
+    std::string s = "str";
+    sig.emit(1.f, 2, s);
+    sig(3.f, 4, s);
+    assert(ff.sum == 6 && calls == 2 && sig.size() == 5);
+
+    dp::util::inplace_function<int(int)> fn = [](int x) { return x * 2; };
+    auto copy = fn;
+    assert(copy(21) == 42 && fn(1) == 2);
+    UNUSED(calls);
+}
+
 int main() {
 
     DP_TEST_FOR(test_util_bind);
 
     DP_TEST_FOR(test_observer_basic);
+    DP_TEST_FOR(test_observer_rcu);
+    DP_TEST_FOR(test_observer_async);
+    DP_TEST_FOR(test_observer_tracked);
     DP_TEST_FOR(test_observer_cb);
     DP_TEST_FOR(test_observer_slots);
     DP_TEST_FOR(test_observer_slots_args);
+    DP_TEST_FOR(test_observer_signal_connections);
+    DP_TEST_FOR(test_observer_inplace_signal);
 
     return 0;
 }
\ No newline at end of file
@@ -10,11 +10,14 @@
 
 #include "design_patterns_cxx/dp-resp-chain.hh"
 
+#include "design_patterns_cxx/dp-common.hh"
 #include "design_patterns_cxx/dp-log.hh"
 #include "design_patterns_cxx/dp-x-test.hh"
 
 #include <utility>
 
+#include <cassert>
+
 #include <iomanip>
 #include <iostream>
 #include <string>
@@ -70,6 +73,59 @@ namespace dp::resp_chain::test {
         std::string _id;
     };
 
+    // a filter rejecting the values which are not multiples of \a keep
+    class F : public receiver_t<StatusCode, int> {
+    public:
+        F(int keep, std::uint64_t &visits)
+            : _keep(keep)
+            , _visits(visits) {}
+        ~F() override {}
+        int keep() const { return _keep; }
+
+    protected:
+        std::optional<StatusCode> on_recv(SenderT *, int &&v) override {
+            _visits++;
+            if (v % _keep != 0) return {};
+            return StatusCode::OK;
+        }
+
+    private:
+        int _keep;
+        std::uint64_t &_visits;
+    };
+
+    struct request {
+        std::string path;
+        int size;
+    };
+
+    // the handlers of a static chain, each one keeps a trace of the visits
+    inline std::string trace;
+
+    struct auth {
+        std::optional<int> operator()(request const &r) const {
+            trace += "auth ";
+            if (r.path.rfind("/admin", 0) == 0) return {};
+            return 200;
+        }
+    };
+
+    struct quota {
+        int limit{1024};
+        std::optional<int> operator()(request const &r) const {
+            trace += "quota ";
+            if (r.size > limit) return {};
+            return 200;
+        }
+    };
+
+    struct route {
+        std::optional<int> operator()(request const &r) const {
+            trace += "route ";
+            return r.path == "/" ? 200 : 404;
+        }
+    };
+
 } // namespace dp::resp_chain::test
 
 void test_resp_chain() {
@@ -97,7 +153,84 @@ void test_resp_chain() {
     // aa.mediator().send([](auto &target, auto &&...) { return target.id() == "bb1"; }, "any");
 }
 
+void test_resp_chain_static() {
+    using namespace dp::resp_chain;
+    using test::request;
+    using test::trace;
+
+    static_chain_of_t<dp::traits::typelist<test::auth, test::quota, test::route>> chain;
+    static_assert(chain.size() == 3);
+
+    trace.clear();
+    auto ret = chain.send(request{"/", 10});
+    assert(ret == 200 && trace == "auth quota route ");
+
+    trace.clear();
+    ret = chain.send(request{"/x", 10});
+    assert(ret == 404 && trace == "auth quota route ");
+
+    trace.clear();
+    ret = chain(request{"/admin/users", 10}); // stops at the first empty result
+    assert(!ret.has_value() && trace == "auth ");
+
+    chain.get<1>().limit = 4;
+    trace.clear();
+    ret = chain.send(request{"/", 10});
+    assert(!ret.has_value() && trace == "auth quota ");
+
+    // lambdas, and several messages
+    int visits{};
+    static_chain c2{
+            [&visits](std::string const &, int n) -> std::optional<int> { visits++; return n; },
+            [&visits](std::string const &s, int n) -> std::optional<int> { visits++; if (s == "stop") return {}; return n * 2; },
+            [&visits](std::string const &, int n) -> std::optional<int> { visits++; return n * 3; },
+    };
+    assert(c2.send(std::string{"go"}, 7) == 21 && visits == 3);
+    assert(!c2.send(std::string{"stop"}, 7).has_value() && visits == 5);
+    std::cout << "static chain: " << trace << ", " << visits << " visits" << '\n';
+    UNUSED(ret);
+}
+
+void test_resp_chain_adaptive() {
+    using namespace dp::resp_chain;
+
+    using R = test::StatusCode;
+    using M = message_chain_t<R, int>;
+    using AA = test::A<R, int>;
+
+    std::uint64_t visits{};
+    M m;
+    for (int keep : {1, 1, 1, 1, 1, 1, 2, 10})
+        m.add_independent_receiver<test::F>(keep, visits);
+    m.add_receiver<test::F>(1, visits); // a dependent one, it must stay the last
+
+    AA aa{"aa"};
+    aa.controller(&m);
+
+    auto run = [&aa, &visits](int n) {
+        visits = 0;
+        for (int i = 0; i < n; i++) aa.send(int{i});
+        return visits;
+    };
+
+    auto before = run(1000);
+    m.enable_adaptive(256);
+    run(1000);
+    auto after = run(1000);
+    std::cout << "visits before: " << before << ", after: " << after << '\n';
+
+    auto f = [&m](std::size_t i) { return std::static_pointer_cast<test::F>(m.receiver(i)); };
+    assert(f(0)->keep() == 10 && f(1)->keep() == 2);
+    assert(m.receiver(8) && f(8)->keep() == 1);
+    assert(after < before / 3);
+    assert(m.stats(0).invocations > 0 && m.stats(0).stops > 0);
+    for (std::size_t i = 0; i < m.size(); i++)
+        std::cout << "  #" << i << " keep=" << f(i)->keep() << " invocations=" << m.stats(i).invocations << " stops=" << m.stats(i).stops << " ns=" << m.stats(i).ns << '\n';
+}
+
 int main() {
     using namespace std::string_view_literals;
     DP_TEST_FOR(test_resp_chain);
+    DP_TEST_FOR(test_resp_chain_static);
+    DP_TEST_FOR(test_resp_chain_adaptive);
 }
\ No newline at end of file
@@ -15,9 +15,17 @@
 
 #include <utility>
 
+#include <cassert>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <iomanip>
 #include <iostream>
+#include <set>
 #include <string>
+#include <thread>
+#include <vector>
 
 namespace dp::msg_disp::test {
 
@@ -49,7 +57,7 @@ namespace dp::msg_disp::test {
         using BaseR = receiver_t<R, Messages...>;
 
     protected:
-        virtual std::optional<R> on_recv(typename BaseR::SenderT *, Messages &&...msgs) override {
+        virtual std::optional<R> on_recv(typename BaseR::SenderT *, Messages const &...msgs) override {
             std::cout << '[' << _id << "} received: ";
             std::tuple tup{msgs...};
             auto &[v, is_broadcast] = tup;
@@ -70,6 +78,80 @@ namespace dp::msg_disp::test {
         std::string _id;
     };
 
+    template<typename R, typename... Messages>
+    class C : public receiver_t<R, Messages...> {
+    public:
+        C(const char *id, std::string &trace)
+            : _id(id)
+            , _trace(trace) {}
+        ~C() override {}
+        using BaseR = receiver_t<R, Messages...>;
+
+    protected:
+        virtual std::optional<R> on_recv(typename BaseR::SenderT *, Messages const &...msgs) override {
+            std::tuple tup{msgs...};
+            auto &[topic, v] = tup;
+            _trace += _id;
+            _trace += ' ';
+            if (v == "quit")
+                return {};
+            std::cout << '[' << _id << "] " << topic << ": " << v << '\n';
+            return R{StatusCode::OK};
+        }
+
+    private:
+        std::string _id;
+        std::string &_trace;
+    };
+
+    template<typename R>
+    class D : public receiver_t<R, int> {
+    public:
+        ~D() override {}
+        using BaseR = receiver_t<R, int>;
+        std::vector<int> seen{};
+        std::set<std::thread::id> threads{};
+
+    protected:
+        virtual std::optional<R> on_recv(typename BaseR::SenderT *, int const &v) override {
+            seen.push_back(v);
+            threads.insert(std::this_thread::get_id());
+            if (v < 0)
+                return {};
+            return R{StatusCode::OK};
+        }
+    };
+
+    // a payload which counts its copies
+    struct blob {
+        std::string data;
+        static inline int copies{};
+        blob(std::string s)
+            : data(std::move(s)) {}
+        blob(blob const &o)
+            : data(o.data) { copies++; }
+        blob(blob &&) = default;
+    };
+
+    template<typename R>
+    class E : public receiver_t<R, std::unique_ptr<blob>> {
+    public:
+        ~E() override {}
+        using BaseR = receiver_t<R, std::unique_ptr<blob>>;
+        std::size_t peeked{};
+        std::unique_ptr<blob> taken{};
+
+    protected:
+        virtual std::optional<R> on_recv(typename BaseR::SenderT *, std::unique_ptr<blob> const &b) override {
+            peeked += b->data.size();
+            return R{StatusCode::OK};
+        }
+        virtual std::optional<R> on_consume(typename BaseR::SenderT *, std::unique_ptr<blob> &&b) override {
+            taken = std::move(b);
+            return R{StatusCode::OK};
+        }
+    };
+
 } // namespace dp::msg_disp::test
 
 void test_msg_dispatch() {
@@ -97,9 +179,172 @@ void test_msg_dispatch() {
     // aa.mediator().send([](auto &target, auto &&...) { return target.id() == "bb1"; }, "any");
 }
 
+void test_msg_dispatch_indexed() {
+    using namespace dp::msg_disp;
+
+    using R = test::StatusCode;
+    using Msg = std::string;
+    using M = indexed_message_bumper_t<std::string, R, Msg, Msg>;
+    using AA = test::A<R, Msg, Msg>;
+    using CC = test::C<R, Msg, Msg>;
+    static_assert(std::is_base_of_v<controller_t<R, Msg, Msg>, M> && !std::is_base_of_v<message_bumper_t<R, Msg, Msg>, M>);
+
+    M m{[](Msg const &topic, Msg const &) { return topic; }};
+
+    AA aa{"aa"};
+    aa.controller(&m);
+
+    std::string trace;
+    m.add_receiver<CC>("order", 0, "o1", trace);
+    m.add_receiver<CC>("order", 10, "o2", trace);
+    m.add_receiver<CC>("quote", 0, "q1", trace);
+    m.add_wildcard_receiver<CC>(5, "w1", trace);
+    auto late = std::make_shared<CC>("o3", trace);
+    m.add_receiver("order", late, 10);
+
+    aa.send("order", "buy");
+    assert(trace == "o2 o3 w1 o1 ");
+    trace.clear();
+
+    aa.send("quote", "1.25");
+    assert(trace == "w1 q1 ");
+    trace.clear();
+
+    aa.send("trade", "none");
+    assert(trace == "w1 ");
+    trace.clear();
+
+    aa.send("order", "quit");
+    assert(trace == "o2 ");
+    trace.clear();
+
+    m.remove_receiver(late);
+    assert(m.receivers("order") == 3 && m.receivers("quote") == 2 && m.receivers("trade") == 1);
+}
+
+void test_msg_dispatch_forwarding() {
+    using namespace dp::msg_disp;
+
+    using R = test::StatusCode;
+    using P = std::unique_ptr<test::blob>;
+    using M = message_bumper_t<R, P>;
+    using AA = test::A<R, P>;
+    using EE = test::E<R>;
+
+    M m;
+    std::vector<std::shared_ptr<EE>> rs;
+    for (int i = 0; i < 3; i++) {
+        rs.push_back(std::make_shared<EE>());
+        m.add_receiver(rs.back());
+    }
+
+    AA aa{"aa"};
+    aa.controller(&m);
+
+    // a move-only message: the first receivers peek at it, the last one takes it over
+    aa.send(std::make_unique<test::blob>("payload"));
+    assert(rs[0]->peeked == 7 && rs[1]->peeked == 7 && !rs[0]->taken && !rs[1]->taken);
+    assert(rs[2]->peeked == 0 && rs[2]->taken && rs[2]->taken->data == "payload");
+
+    // an lvalue is only ever seen by const&
+    P keep = std::make_unique<test::blob>("kept");
+    aa.send(keep);
+    assert(keep && rs[2]->peeked == 4);
+
+    // a copyable message is never copied on the way, no matter how many receivers there are
+    using M2 = message_bumper_t<R, test::blob, bool>;
+    using A2 = test::A<R, test::blob, bool>;
+    M2 m2;
+    struct F : receiver_t<R, test::blob, bool> {
+        std::size_t n{};
+        std::optional<R> on_recv(SenderT *, test::blob const &b, bool const &) override {
+            n += b.data.size();
+            return R::OK;
+        }
+    };
+    for (int i = 0; i < 8; i++)
+        m2.add_receiver<F>();
+    A2 a2{"a2"};
+    a2.controller(&m2);
+    test::blob big{std::string(4096, 'x')};
+    test::blob::copies = 0;
+    a2.send(big, false);
+    a2.send(test::blob{std::string(4096, 'y')}, true);
+    assert(test::blob::copies == 0);
+    std::cout << "copies: " << test::blob::copies << '\n';
+}
+
+void test_msg_dispatch_async() {
+    using namespace dp::msg_disp;
+
+    using R = test::StatusCode;
+    using M = async_message_bumper_t<R, int>;
+    using AA = test::A<R, int>;
+    using DD = test::D<R>;
+    static_assert(std::is_base_of_v<controller_t<R, int>, M> && !std::is_base_of_v<message_bumper_t<R, int>, M>);
+
+    M m{4};
+    std::vector<std::shared_ptr<DD>> rs;
+    for (int i = 0; i < 8; i++) {
+        rs.push_back(std::make_shared<DD>());
+        m.add_receiver(rs.back());
+    }
+
+    AA aa{"aa"};
+    aa.controller(&m);
+
+    const int n = 10000;
+    std::vector<reply_t<R>> replies;
+    for (int i = 0; i < n; i++)
+        replies.push_back(m.post(&aa, int{i}));
+    for (auto &r : replies)
+        DP_TEST_CHECK(r.get() == R::OK, "every post should be answered OK");
+
+    auto r = aa.send(-1); // a receiver returning empty makes the combined result empty
+    DP_TEST_CHECK(!r.has_value(), "an empty result should empty the combined one");
+
+    m.stop();
+    DP_TEST_CHECK(!m.post(&aa, 1).get().has_value(), "a post after stop() should be answered empty");
+
+    std::set<std::thread::id> workers;
+    for (auto &rc : rs) {
+        DP_TEST_CHECK(rc->seen.size() == n + 1, "every receiver should see every message");
+        DP_TEST_CHECK(std::is_sorted(rc->seen.begin(), rc->seen.end() - 1), "in posted order");
+        DP_TEST_CHECK(rc->threads.size() == 1, "pinned to one shard");
+        workers.insert(rc->threads.begin(), rc->threads.end());
+    }
+    std::cout << rs.size() << " receivers ran on " << workers.size() << " workers" << '\n';
+    DP_TEST_CHECK(workers.size() == m.shards(), "every shard should run a receiver");
+
+    // posts racing stop() on a tiny mailbox are either run or answered empty, never lost
+    for (int round = 0; round < 20; round++) {
+        M m2{1, 2};
+        auto d = std::make_shared<DD>();
+        m2.add_receiver(d);
+        std::atomic<int> ok{}, empty{};
+        std::vector<std::thread> posters;
+        for (int t = 0; t < 4; t++)
+            posters.emplace_back([&m2, &aa, &ok, &empty] {
+                for (int i = 0; i < 200; i++) {
+                    if (m2.post(&aa, int{i}).get().has_value())
+                        ok++;
+                    else
+                        empty++;
+                }
+            });
+        std::this_thread::sleep_for(std::chrono::microseconds(round * 50));
+        m2.stop();
+        for (auto &t : posters) t.join();
+        DP_TEST_CHECK(ok + empty == 800 && (int) d->seen.size() == ok, "a post should be run or answered empty");
+    }
+}
+
 int main() {
     using namespace std::string_view_literals;
     DP_TEST_FOR(test_msg_dispatch);
+    DP_TEST_FOR(test_msg_dispatch_indexed);
+    DP_TEST_FOR(test_msg_dispatch_forwarding);
+    DP_TEST_FOR(test_msg_dispatch_async);
 
     auto i{1};
     std::map<int, int> iim;
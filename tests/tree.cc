@@ -18,7 +18,11 @@
 #include "design_patterns_cxx/dp-x-test.hh"
 
 #include <algorithm>
+#include <atomic>
 #include <iostream>
+#include <set>
+#include <string>
+#include <thread>
 #include <utility>
 #include <vector>
 
@@ -99,6 +103,334 @@ void test_rb_tree() {
   }
 }
 
+void test_rb_tree_slab() {
+  using node = dp::tree::detail::rb_node_t<int>;
+  using alloc = dp::tree::slab_allocator<int>;
+  dp::tree::rb_tree<int, node, alloc> t;
+
+  constexpr int n = 100000;
+  for (int i = 0; i < n; i++)
+    t.insert((i * 7919) % n);
+  t.insert(42); // a duplicate, its node goes back to the free list
+  DP_TEST_CHECK(t.count() == n, "bad tree count");
+
+  auto cap = t.get_node_allocator().capacity();
+  for (int i = 0; i < n; i += 2)
+    t.erase(i);
+  for (int i = 0; i < n; i += 2)
+    t.insert(i);
+  DP_TEST_CHECK(t.count() == n, "bad tree count");
+  // the freed nodes were reused, the arena did not grow
+  DP_TEST_CHECK(t.get_node_allocator().capacity() == cap, "slab arena grew");
+
+  int last = -1;
+  bool sorted = true;
+  t.traverse_in_order(t.root(), [&last, &sorted](auto *p) {
+    sorted = sorted && p->key > last;
+    last = p->key;
+  });
+  DP_TEST_CHECK(sorted && last == n - 1, "bad in-order");
+
+  t.clear();
+  DP_TEST_CHECK(t.count() == 0 && t.get_node_allocator().capacity() == 0, "clear() should release the arena");
+  for (int i = 0; i < 10; i++)
+    t.insert(i);
+  DP_TEST_CHECK(t.count() == 10, "bad tree count");
+
+  // a moved-from tree takes a new arena and keeps working
+  auto moved = std::move(t);
+  DP_TEST_CHECK(moved.count() == 10 && t.count() == 0, "bad tree count after move");
+  for (int i = 0; i < 100; i++)
+    t.insert(i);
+  DP_TEST_CHECK(t.count() == 100 && moved.count() == 10, "bad tree count after move");
+  DP_TEST_CHECK(t.get_node_allocator() != moved.get_node_allocator(), "a moved-from tree should not share the arena");
+  decltype(t) assigned;
+  assigned = std::move(t);
+  t.insert(1);
+  DP_TEST_CHECK(t.count() == 1 && assigned.count() == 100, "bad tree count after move assignment");
+
+  // a tree given an allocator takes its nodes from that arena, the rebound copies share it
+  alloc mine;
+  {
+    dp::tree::rb_tree<int, node, alloc> shared{mine};
+    for (int i = 0; i < 10; i++)
+      shared.insert(i);
+    dp::tree::slab_allocator<node> nodes{mine};
+    DP_TEST_CHECK(shared.get_allocator() == mine && shared.get_node_allocator() == mine && nodes.in_use() == 10, "the nodes must come from the arena given");
+    DP_TEST_CHECK(mine.in_use() == 0 && mine != alloc{}, "the arena must keep a pool per object size");
+    shared.clear(); // the arena is shared, the nodes are freed one by one
+    DP_TEST_CHECK(nodes.in_use() == 0 && nodes.capacity() > 0, "clear() must not release a shared arena");
+  }
+
+  // non-trivial keys are destroyed before the arena goes
+  dp::tree::rb_tree<std::string, dp::tree::detail::rb_node_t<std::string>, dp::tree::slab_allocator<std::string>> ts;
+  for (int i = 0; i < 1000; i++)
+    ts.insert(std::string(64, char('a' + i % 26)) + std::to_string(i));
+  DP_TEST_CHECK(ts.count() == 1000, "bad tree count");
+  ts.clear();
+
+  // and the default allocator tears a big tree down without recursion
+  dp::tree::rb_tree<int> big;
+  for (int i = 0; i < n; i++)
+    big.insert(i);
+  big.clear();
+  DP_TEST_CHECK(big.count() == 0, "bad tree count");
+}
+
+namespace traversals {
+  using node = dp::tree::detail::rb_node_t<int>;
+
+  // the recursive references
+  inline void in_order(node *n, std::vector<int> &out) {
+    if (!n) return;
+    in_order(n->left, out), out.push_back(n->key), in_order(n->right, out);
+  }
+  inline void pre_order(node *n, std::vector<int> &out) {
+    if (!n) return;
+    out.push_back(n->key), pre_order(n->left, out), pre_order(n->right, out);
+  }
+  inline void post_order(node *n, std::vector<int> &out) {
+    if (!n) return;
+    post_order(n->left, out), post_order(n->right, out), out.push_back(n->key);
+  }
+
+  template<typename Range>
+  inline std::vector<int> keys(Range &&r) {
+    std::vector<int> out;
+    for (auto &n : r) out.push_back(n.key);
+    return out;
+  }
+} // namespace traversals
+
+void test_rb_tree_traversals() {
+  using namespace traversals;
+  dp::tree::rb_tree<int> t;
+  for (int i = 0; i < 1000; i++)
+    t.insert((i * 7919) % 1000);
+  auto *root = t.root();
+
+  std::vector<int> ref, got;
+  auto collect = [&got](node *n) { got.push_back(n->key); };
+
+  in_order(root, ref);
+  t.traverse_in_order(root, collect);
+  DP_TEST_CHECK(got == ref && keys(t.in_order(root)) == ref, "bad in-order");
+  std::reverse(ref.begin(), ref.end());
+  got.clear();
+  t.traverse_in_order_rev(root, collect);
+  DP_TEST_CHECK(got == ref, "bad reversed in-order");
+
+  ref.clear(), got.clear();
+  pre_order(root, ref);
+  t.traverse_pre_order(root, collect);
+  DP_TEST_CHECK(got == ref && keys(t.pre_order(root)) == ref, "bad pre-order");
+
+  ref.clear(), got.clear();
+  post_order(root, ref);
+  t.traverse_post_order(root, collect);
+  DP_TEST_CHECK(got == ref && keys(t.post_order(root)) == ref, "bad post-order");
+
+  got.clear();
+  t.traverse_level_order(root, collect);
+  DP_TEST_CHECK(got == keys(t.level_order(root)) && got.size() == 1000 && got[0] == root->key, "bad level-order");
+  std::size_t levels{};
+  t.traverse_levels(root, [&levels](node *, std::size_t level) { levels = level + 1; });
+  DP_TEST_CHECK(levels == t.height(), "bad height");
+
+  // a subtree only
+  ref.clear();
+  in_order(root->left, ref);
+  DP_TEST_CHECK(keys(t.in_order(root->left)) == ref, "bad subtree in-order");
+
+  // a visitor returning false stops the walk
+  got.clear();
+  t.traverse_in_order(root, [&got](node *n) { got.push_back(n->key); return got.size() < 10; });
+  DP_TEST_CHECK(got.size() == 10 && got.back() == 9, "bad early stop");
+
+  // a degenerate chain much deeper than the call stack would bear
+  constexpr int depth = 1000000;
+  std::vector<node> chain(depth);
+  for (int i = 0; i < depth; i++) {
+    chain[i].key = depth - i;
+    if (i > 0) chain[i].parent = &chain[i - 1], chain[i - 1].left = &chain[i];
+  }
+  long long sum{};
+  t.traverse_in_order(&chain[0], [&sum](node *n) { sum += n->key; });
+  t.traverse_post_order(&chain[0], [&sum](node *n) { sum -= n->key; });
+  int count{}, last{};
+  for (auto &n : t.in_order(&chain[0])) count++, last = n.key;
+  DP_TEST_CHECK(sum == 0 && count == depth && last == depth, "bad deep walk");
+  for (auto &n : chain) n.left = n.parent = nullptr;
+}
+
+void test_rb_tree_order_statistics() {
+  dp::tree::os_rb_tree<int> t;
+  constexpr int n = 10000;
+  for (int i = 0; i < n; i++)
+    t.insert((i * 7919) % n * 2); // the even numbers in [0, 2n)
+  t.insert(0);                   // a duplicate, not counted
+  assertm(t.count() == n && t.size() == n, "bad tree count");
+  assertm(t.height() <= t.height_bound(), "height above its bound");
+  std::cout << "  height: " << t.height() << ", black height: " << t.black_height() << ", bound: " << t.height_bound() << '\n';
+
+  assertm(t.rank(0) == 0 && t.rank(1) == 1 && t.rank(2 * 500) == 500 && t.rank(2 * n) == n, "bad rank");
+  assertm(t.select(0)->key == 0 && t.select(123)->key == 246 && t.select(n - 1)->key == 2 * (n - 1), "bad select");
+  assertm(t.select(n) == nullptr, "select() beyond the end");
+
+  for (int i = 0; i < n; i += 2)
+    t.erase(2 * i); // the multiples of 4 go
+  assertm(t.count() == n / 2, "bad tree count after erase");
+  assertm(t.select(0)->key == 2 && t.select(1)->key == 6 && t.rank(7) == 2, "bad order statistics after erase");
+  for (int i = 0; i < n / 2; i++)
+    assertm(t.rank(t.select(i)->key) == (std::size_t) i, "rank(select(i)) != i");
+
+  t.clear();
+  assertm(t.empty() && t.black_height() == 0, "bad clear");
+}
+
+namespace ordered {
+  // a key which counts its copies and moves
+  struct key {
+    int v;
+    std::string s;
+    static inline int copies{};
+    key(int v_, char const *s_)
+        : v(v_)
+        , s(s_) {}
+    key(key const &o)
+        : v(o.v)
+        , s(o.s) { copies++; }
+    key(key &&o) noexcept
+        : v(o.v)
+        , s(std::move(o.s)) { copies++; }
+    friend bool operator<(key const &a, key const &b) { return a.v < b.v; }
+  };
+  struct by_v {
+    using is_transparent = void;
+    bool operator()(key const &a, key const &b) const { return a.v < b.v; }
+    bool operator()(key const &a, int b) const { return a.v < b; }
+    bool operator()(int a, key const &b) const { return a < b.v; }
+  };
+
+  // the std::set API of rb_tree and btree, on a set of the even numbers in [0, 2n)
+  template<typename Set>
+  inline void check_set_api(Set &t, int n) {
+    auto const size = [&t](int k) { return t.size() == std::size_t(k); };
+    auto [dup, added] = t.insert(10);
+    DP_TEST_CHECK(!added && *dup == 10 && size(n), "bad insert of a duplicate");
+
+    DP_TEST_CHECK(std::is_sorted(t.begin(), t.end()) && std::distance(t.begin(), t.end()) == n, "bad iteration");
+    DP_TEST_CHECK(*t.rbegin() == 2 * (n - 1) && *--t.end() == 2 * (n - 1) && *std::prev(t.end(), 2) == 2 * (n - 2), "bad reverse iteration");
+    DP_TEST_CHECK(t.contains(42) && !t.contains(43) && t.count(42) == 1 && t.find(43) == t.end(), "bad find");
+    DP_TEST_CHECK(*t.lower_bound(42) == 42 && *t.lower_bound(43) == 44 && *t.upper_bound(42) == 44, "bad bounds");
+    DP_TEST_CHECK(t.lower_bound(2 * n) == t.end() && t.upper_bound(2 * (n - 1)) == t.end() && t.upper_bound(-1) == t.begin(), "bad bounds at the ends");
+    auto [lo, hi] = t.equal_range(42);
+    DP_TEST_CHECK(std::distance(lo, hi) == 1 && t.equal_range(43).first == t.equal_range(43).second, "bad equal_range");
+
+    DP_TEST_CHECK(t.erase(42) == 1 && t.erase(42) == 0 && size(n - 1), "bad erase by key");
+    auto next = t.erase(t.find(40));
+    DP_TEST_CHECK(*next == 44 && size(n - 2), "bad erase by iterator");
+  }
+} // namespace ordered
+
+void test_rb_tree_ordered() {
+  dp::tree::rb_tree<int> t;
+  for (int i = 0; i < 100; i++)
+    t.insert((i * 37) % 100 * 2); // the even numbers in [0, 200)
+  ordered::check_set_api(t, 100);
+
+  auto next = t.erase(t.lower_bound(100), t.lower_bound(150)); // 100, 102, ..., 148
+  DP_TEST_CHECK(*next == 150 && t.size() == 73 && !t.contains(120), "bad erase of a range");
+  DP_TEST_CHECK(std::is_sorted(t.begin(), t.end()), "bad order after erase");
+  t.erase(t.begin(), t.end());
+  DP_TEST_CHECK(t.empty() && t.begin() == t.end(), "bad erase of all");
+
+  // emplace builds the key in its node, the lookups take an int
+  dp::tree::rb_tree<ordered::key, dp::tree::detail::rb_node_t<ordered::key>, std::allocator<ordered::key>, ordered::by_v> tk;
+  ordered::key::copies = 0;
+  for (int i = 0; i < 10; i++)
+    tk.emplace(9 - i, "k");
+  tk.emplace(3, "dup");
+  DP_TEST_CHECK(ordered::key::copies == 0 && tk.size() == 10, "emplace copied a key");
+  DP_TEST_CHECK(tk.contains(3) && tk.find(3)->s == "k" && tk.lower_bound(5)->v == 5, "bad heterogeneous lookup");
+  DP_TEST_CHECK(tk.erase(3) == 1 && !tk.contains(3), "bad heterogeneous erase");
+  std::cout << "  keys:";
+  for (auto const &k : tk) std::cout << ' ' << k.v;
+  std::cout << '\n';
+}
+
+void test_rb_tree_bulk() {
+  constexpr int n = 100000;
+  std::vector<int> keys;
+  for (int i = 0; i < n; i++)
+    keys.push_back(i * 2);
+  keys.push_back(keys.back()); // a duplicate, dropped
+
+  auto t = dp::tree::os_rb_tree<int>::from_sorted(keys.begin(), keys.end());
+  assertm(t.size() == n && std::equal(t.begin(), t.end(), keys.begin()), "bad from_sorted");
+  assertm(t.height() <= t.height_bound() && t.height() == 17, "from_sorted should build a balanced tree");
+  assertm(!t.root()->color_is_red && t.rank(1000) == 500 && t.select(n - 1)->key == 2 * (n - 1), "bad order statistics after from_sorted");
+  t.erase(0);
+  t.insert(1);
+  assertm(t.size() == n && *t.begin() == 1, "bad tree after from_sorted");
+
+  // merging the odd numbers, 1 and 4 are in both
+  dp::tree::os_rb_tree<int> odd;
+  for (int i = 0; i < n; i++)
+    odd.insert(i * 2 + 1);
+  odd.insert(4);
+  t.merge(std::move(odd));
+  assertm(odd.empty() && t.size() == 2 * n - 1 && t.height() <= t.height_bound(), "bad merge");
+  int expect = 1;
+  bool ok = true;
+  for (auto k : t) ok = ok && k == expect++;
+  assertm(ok && t.rank(1000) == 999, "bad keys after merge");
+
+  // with slab_allocator, the nodes of another arena are not relinked but copied
+  using slab_tree = dp::tree::rb_tree<int, dp::tree::detail::rb_node_t<int>, dp::tree::slab_allocator<int>>;
+  auto s1 = slab_tree::from_sorted(keys.begin(), keys.begin() + 10);
+  auto s2 = slab_tree::from_sorted(keys.begin() + 5, keys.begin() + 20);
+  s1.merge(std::move(s2));
+  assertm(s1.size() == 20 && s1.get_node_allocator().in_use() == 20 && s2.get_node_allocator().in_use() == 0, "bad merge of slab trees");
+  std::cout << "  height: " << t.height() << ", black height: " << t.black_height() << '\n';
+}
+
+void test_btree() {
+  // small nodes, so that a few thousand keys make several levels
+  using small_btree = dp::tree::btree<int, std::less<int>, std::allocator<int>, 64>;
+  small_btree t;
+  constexpr int n = 10000;
+  for (int i = 0; i < n; i++)
+    t.insert((i * 7919) % n * 2); // the even numbers in [0, 2n)
+  DP_TEST_CHECK(t.height() > 3, "too few levels");
+  ordered::check_set_api(t, n); // 40 and 42 are erased
+
+  // a range scan walks the linked leaves
+  long long sum{};
+  for (auto it = t.lower_bound(1000); it != t.end() && *it < 2000; ++it) sum += *it;
+  DP_TEST_CHECK(sum == 500LL * (1000 + 1998) / 2, "bad range scan");
+
+  // erasing merges and rebalances the nodes, down to an empty tree
+  auto next = t.erase(t.lower_bound(100), t.lower_bound(10000));
+  DP_TEST_CHECK(*next == 10000 && !t.contains(5000) && t.size() == n - 2 - 4950, "bad erase of a range");
+  for (int i = 0; i < 2 * n; i += 4) t.erase(i);
+  DP_TEST_CHECK(std::is_sorted(t.begin(), t.end()) && t.size() == n - 2 - 4950 - 2524, "bad erase");
+  t.erase(t.begin(), t.end());
+  DP_TEST_CHECK(t.empty() && t.begin() == t.end() && t.height() == 0, "bad erase of all");
+
+  // sorted loads fill the leaves up
+  for (int i = 0; i < n; i++) t.insert(i);
+  DP_TEST_CHECK(t.size() == n && *t.begin() == 0 && *t.rbegin() == n - 1, "bad sorted load");
+
+  // any key type, heterogeneous lookup
+  dp::tree::btree<std::string, std::less<>> ts;
+  for (int i = 0; i < 1000; i++) ts.emplace(std::to_string(i));
+  ts.emplace(3, 'x');
+  DP_TEST_CHECK(ts.size() == 1001 && ts.contains("xxx") && ts.contains(std::string_view{"999"}), "bad string btree");
+  DP_TEST_CHECK(ts.erase("500") == 1 && *ts.lower_bound("500") == "501", "bad string erase");
+  std::cout << "  height: " << t.height() << ", keys per leaf: " << small_btree::leaf_capacity << ", per inner node: " << small_btree::inner_capacity << '\n';
+}
+
 void test_invalid_iterator() {
   std::vector<int> vi{3, 7};
   auto it = vi.begin();
@@ -395,7 +727,8 @@ void test_g_tree() {
     t.emplace(v, buf.data());
 
     {
-      auto b = t.root().begin(), e = t.root().end();
+      auto b = t.root().begin();
+      auto e = t.root().rbegin();
       auto &bNode = (*b), &eNode = (*e);
       std::cout << "::: " << (*bNode) << '\n'; // print bNode.data()
       std::cout << "::: " << (eNode.data()) << '\n';
@@ -454,14 +787,177 @@ void test_g_tree() {
     }
   }
   std::cout << '\n';
+
+  // 9 got the children 10 and 11
+  auto values = [](auto b, auto e) {
+    std::vector<int> v;
+    for (; b != e; ++b) v.push_back((*b)->val);
+    return v;
+  };
+  using CF = decltype(t)::NodeT::children_first_iter_data;
+  DP_TEST_CHECK((values(t.begin(), t.end()) == std::vector<int>{1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11}), "bad preorder");
+  DP_TEST_CHECK((values(t.rbegin(), t.rend()) == std::vector<int>{11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1}), "bad reverse preorder");
+  DP_TEST_CHECK((values(CF::begin(&t.root()), CF::end(&t.root())) == std::vector<int>{2, 3, 4, 5, 6, 7, 8, 10, 11, 9, 1}), "bad postorder");
+  auto &nine = t.root()[7];
+  DP_TEST_CHECK((values(nine.begin(), nine.end()) == std::vector<int>{9, 10, 11}), "bad subtree");
+  t.root().erase(0);
+  DP_TEST_CHECK((values(t.begin(), t.end()) == std::vector<int>{1, 3, 4, 5, 6, 7, 8, 9, 10, 11}), "bad erase");
+}
+
+void test_g_tree_parallel() {
+  // a root with 100 children of 100 children each
+  dp::tree::tree_t<int> t;
+  using node = decltype(t)::NodeT;
+  t.insert(0);
+  for (int i = 1; i <= 100; i++) {
+    t.insert(i);
+    for (int j = 1; j <= 100; j++)
+      t.root()[i - 1].emplace(i * 1000 + j);
+  }
+
+  std::atomic<int> visited{};
+  t.parallel_for_each([&visited](node &n) { visited++, (*n) *= 2; }, 4);
+  DP_TEST_CHECK(visited == 10101, "bad parallel_for_each");
+
+  auto sum = t.transform_reduce(0LL, std::plus<>{}, [](node const &n) { return (long long) *n; }, 4);
+  auto expect = t.transform_reduce(0LL, std::plus<>{}, [](node const &n) { return (long long) *n; }, 1);
+  long long seq{};
+  for (auto &n : t) seq += *n;
+  DP_TEST_CHECK(sum == seq && expect == seq, "bad transform_reduce");
+
+  auto const &ct = t;
+  auto it = ct.parallel_find([](node const &n) { return *n == 2 * 42'042; }, 4);
+  DP_TEST_CHECK(it != ct.end() && **it == 2 * 42'042, "bad parallel_find");
+  DP_TEST_CHECK(ct.parallel_find([](node const &n) { return *n == 1; }, 4) == ct.end(), "parallel_find found a missing value");
+  std::cout << "  sum: " << sum << '\n';
+
+  // a single wide node, its children are shared out too
+  dp::tree::tree_t<int> wide;
+  wide.insert(0);
+  for (int i = 1; i <= 10000; i++)
+    wide.insert(i);
+  visited = 0;
+  wide.parallel_for_each([&visited](node const &) { visited++; }, 4);
+  DP_TEST_CHECK(visited == 10001, "bad parallel_for_each on a wide node");
+  auto wsum = wide.transform_reduce(0LL, std::plus<>{}, [](node const &n) { return (long long) *n; }, 4);
+  DP_TEST_CHECK(wsum == 10000LL * 10001 / 2, "bad transform_reduce on a wide node");
+}
+
+void test_flat_tree() {
+  dp::tree::flat_tree_t<tree_data> t;
+  DP_TEST_CHECK(t.begin() == t.end() && t.rbegin() == t.rend(), "an empty tree should have no nodes");
+
+  std::array<char, 128> buf;
+  auto make = [&buf](int v) {
+    std::snprintf(buf.data(), buf.size(), "str#%d", v);
+    return tree_data{v, buf.data()};
+  };
+
+  //     1
+  //  2  3  4
+  // 5 6   7
+  t.insert(make(1));
+  auto n2 = t.insert(make(2)), n3 = t.insert(make(3)), n4 = t.insert(make(4));
+  t.insert_child(n2, make(5));
+  t.insert_child(n2, make(6));
+  t.insert_child(n4, make(7));
+  UNUSED(n3);
+  DP_TEST_CHECK(t.size() == 7 && t.root().size() == 3 && !t.is_preorder(), "bad inserts");
+
+  auto preorder = [](auto const &tt) {
+    std::vector<int> v;
+    for (auto const &n : tt) v.push_back(n->val);
+    return v;
+  };
+  std::vector<int> want{1, 2, 5, 6, 3, 4, 7};
+  DP_TEST_CHECK(preorder(t) == want, "bad preorder");
+  std::vector<int> rev;
+  for (auto it = t.rbegin(); it != t.rend(); ++it) rev.push_back((*it)->val);
+  DP_TEST_CHECK(std::equal(rev.rbegin(), rev.rend(), want.begin()), "bad reverse preorder");
+
+  auto copy = t;
+  t.compact();
+  DP_TEST_CHECK(t.is_preorder() && preorder(t) == want && preorder(copy) == want, "bad compact");
+  std::vector<int> sub;
+  for (auto const &n : t.subtree(1)) sub.push_back(n->val);
+  DP_TEST_CHECK((sub == std::vector<int>{2, 5, 6}), "bad subtree");
+
+  auto it = t.find([](auto const &n) { return n->val == 7; });
+  DP_TEST_CHECK(it != t.end() && t[it->parent()]->val == 4, "bad find");
+  for (auto &n : t) std::cout << (*n) << ", ";
+  std::cout << '\n';
+}
+
+void test_concurrent_skip_list() {
+  dp::tree::concurrent_skip_list<int> s;
+  for (int i = 0; i < 1000; i++)
+    s.insert((i * 7919) % 1000);
+  assertm(s.size() == 1000 && !s.insert(5) && s.contains(5) && !s.contains(1000), "bad insert");
+  assertm(s.erase(5) && !s.erase(5) && !s.contains(5) && s.size() == 999, "bad erase");
+  assertm(*s.lower_bound(5) == 6 && !s.lower_bound(1000).has_value(), "bad lower_bound");
+  std::vector<int> got;
+  s.range(10, 20, [&got](int k) { got.push_back(k); });
+  assertm(got.size() == 10 && got.front() == 10 && got.back() == 19, "bad range");
+  got.clear();
+  s.for_each([&got](int k) { got.push_back(k); return got.size() < 100; });
+  assertm(got.size() == 100 && std::is_sorted(got.begin(), got.end()), "bad for_each");
+
+  // the writers own the keys k % writers == w, the readers scan meanwhile
+  constexpr int writers = 4, readers = 4, n = 20000;
+  s.clear();
+  std::atomic<bool> stop{};
+  std::atomic<int> unsorted{};
+  std::vector<std::set<int>> own(writers);
+  std::vector<std::thread> threads;
+  for (int w = 0; w < writers; w++)
+    threads.emplace_back([&s, &own, w] {
+      for (int i = 0; i < n; i++) {
+        int k = (i * 7919 % 997) * writers + w;
+        if (i % 3 != 2)
+          s.insert(k), own[w].insert(k);
+        else
+          s.erase(k), own[w].erase(k);
+      }
+    });
+  for (int r = 0; r < readers; r++)
+    threads.emplace_back([&s, &stop, &unsorted] {
+      while (!stop) {
+        int last = -1;
+        s.for_each([&last, &unsorted](int k) {
+          if (k <= last) unsorted++;
+          last = k;
+        });
+      }
+    });
+  for (int w = 0; w < writers; w++) threads[w].join();
+  stop = true;
+  for (int r = 0; r < readers; r++) threads[writers + r].join();
+
+  std::size_t total{};
+  bool all = true;
+  for (auto &o : own) {
+    total += o.size();
+    for (auto k : o) all = all && s.contains(k);
+  }
+  assertm(unsorted == 0 && all && s.size() == total, "bad concurrent updates");
+  std::cout << "  keys: " << s.size() << '\n';
 }
 
 int main() {
   DP_TEST_FOR(test_rb_tree_decr);
   DP_TEST_FOR(test_rb_tree_incr);
   DP_TEST_FOR(test_rb_tree);
+  DP_TEST_FOR(test_rb_tree_slab);
+  DP_TEST_FOR(test_rb_tree_traversals);
+  DP_TEST_FOR(test_rb_tree_order_statistics);
+  DP_TEST_FOR(test_rb_tree_ordered);
+  DP_TEST_FOR(test_rb_tree_bulk);
+  DP_TEST_FOR(test_btree);
+  DP_TEST_FOR(test_concurrent_skip_list);
 
   DP_TEST_FOR(test_g_tree);
+  DP_TEST_FOR(test_g_tree_parallel);
+  DP_TEST_FOR(test_flat_tree);
 
   DP_TEST_FOR(customized_iterators::test_range);
 }
\ No newline at end of file